@@ -2,15 +2,21 @@
 #define ALLOC_H
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+
+#ifdef ALLOC_REGISTRY
+#include <signal.h>
+#include <stdatomic.h>
+#endif
 
 #define ARENA_IMPL
 #include "allocators/arena.h"
 
 /* TODO(September 07, 2025): replace all asserts with logging and early safe returns */
 /* TODO(September 07, 2025): shorten the 'allocator_' prefix of functions, like 'alloc_' or even 'a_' or 'alc_' */
-/* TODO(September 07, 2025): add 'realloc' for all types of allocators */
 /* TODO(September 08, 2025): make a default allocator */
 /* TODO(September 08, 2025): implement freelist */
 /* TODO(September 08, 2025): rightn now the "arena" is a hybrid beteween a bump allocator and an arena, so decide which to implement */
@@ -29,10 +35,33 @@ typedef struct allocator_stats {
     size_t peak;
 } allocator_stats_t;
 
+/* the owner is the only writer of the stats, but the registry reads them from
+ * other threads, so every access is a relaxed atomic (a plain mov on x86) */
+#define allocator_stat_get(_f)     __atomic_load_n(&(_f), __ATOMIC_RELAXED)
+#define allocator_stat_set(_f, _v) __atomic_store_n(&(_f), (_v), __ATOMIC_RELAXED)
+
+#ifdef ALLOC_HISTOGRAM
+/* allocation size histogram: linear buckets of (1 << STEP_SHIFT) bytes up to
+ * (1 << LINEAR_SHIFT) bytes, then one bucket per power of two */
+#ifndef ALLOC_HISTOGRAM_LINEAR_SHIFT
+#define ALLOC_HISTOGRAM_LINEAR_SHIFT (8u)
+#endif
+#ifndef ALLOC_HISTOGRAM_STEP_SHIFT
+#define ALLOC_HISTOGRAM_STEP_SHIFT   (4u)
+#endif
+#define ALLOC_HISTOGRAM_LINEAR_BUCKETS (1u << (ALLOC_HISTOGRAM_LINEAR_SHIFT - ALLOC_HISTOGRAM_STEP_SHIFT))
+#define ALLOC_HISTOGRAM_BUCKETS        (ALLOC_HISTOGRAM_LINEAR_BUCKETS + 64u - ALLOC_HISTOGRAM_LINEAR_SHIFT)
+
+typedef struct allocator_histogram {
+    size_t count[ALLOC_HISTOGRAM_BUCKETS];
+    size_t bytes[ALLOC_HISTOGRAM_BUCKETS];
+} allocator_histogram_t;
+#endif
+
 /* alloc and free function pointers */
 typedef void *(*alloc_fn)  (allocator_t*, size_t n);
 typedef void  (*free_fn)   (allocator_t*, void *p);
-typedef void *(*realloc_fn)(allocator_t*, void *p);
+typedef void *(*realloc_fn)(allocator_t*, void *p, size_t old_size, size_t new_size);
 
 /* tag union allocator type */
 typedef struct allocator {
@@ -43,16 +72,86 @@ typedef struct allocator {
          arena_t arena;
     };
     allocator_stats_t stats;
+#ifdef ALLOC_HISTOGRAM
+    allocator_histogram_t histogram;
+#endif
     allocator_type_t  type;
+    const char       *name;
+#ifdef ALLOC_REGISTRY
+    size_t registry_slot; /* slot index + 1, 0 when not registered */
+#endif
 } allocator_t;
 
+/* stats output sink: a FILE* or a caller-supplied buffer. 'len' counts every
+ * byte produced, so len >= cap after a write means the buffer was truncated */
+typedef struct allocator_writer {
+    FILE   *file;
+    char   *buf;
+    size_t  cap, len;
+} allocator_writer_t;
+
+/* one allocator in a stats export, 'labels' is an optional NULL-terminated
+ * list of alternating keys and values: { "tenant", "a", "pool", "io", NULL } */
+typedef struct allocator_entry {
+    allocator_t        *allocator;
+    const char         *name;
+    const char *const  *labels;
+} allocator_entry_t;
+
 /* general allocator functions */
 void allocator_init       (allocator_t *a, allocator_type_t type);
+void allocator_init_named (allocator_t *a, allocator_type_t type, const char *name);
 void allocator_deinit     (allocator_t *a);
 void allocator_dump_stats (allocator_t *a, const char* name);
 
-void *mem_alloc (allocator_t *a, size_t size);
-void mem_free   (allocator_t *a, void *p);
+const char *allocator_type_name (allocator_type_t type);
+
+/* stats export functions, return the number of bytes produced */
+allocator_writer_t allocator_writer_file        (FILE *file);
+allocator_writer_t allocator_writer_buffer      (char *buf, size_t cap);
+void               allocator_writer_printf      (allocator_writer_t *w, const char *fmt, ...);
+size_t             allocator_stats_json         (allocator_writer_t *w, const allocator_entry_t *entries, size_t n);
+size_t             allocator_stats_openmetrics  (allocator_writer_t *w, const allocator_entry_t *entries, size_t n);
+
+#ifdef ALLOC_HISTOGRAM
+/* size histogram functions */
+const allocator_histogram_t *allocator_get_histogram     (allocator_t *a);
+size_t                       allocator_histogram_bucket  (size_t size);
+void                         allocator_histogram_range   (size_t bucket, size_t *lo, size_t *hi);
+void                         allocator_dump_histogram    (allocator_t *a, const char* name);
+void                         allocator_dump_histogram_json (allocator_t *a, const char* name, FILE *out);
+#endif
+
+void *mem_alloc   (allocator_t *a, size_t size);
+void *mem_calloc  (allocator_t *a, size_t count, size_t size);
+void  mem_free    (allocator_t *a, void *p);
+void *mem_realloc (allocator_t *a, void *p, size_t old_size, size_t new_size);
+
+#ifdef ALLOC_REGISTRY
+/* process-wide registry of live allocators, filled by allocator_init and
+ * emptied by allocator_deinit. Readers never block, allocator_deinit waits
+ * for the readers already in flight before the allocator memory can go away,
+ * readers arriving later do not delay it. Snapshots are not consistent across
+ * fields: each counter is read atomically while its owner keeps allocating */
+#ifndef ALLOC_REGISTRY_MAX
+#define ALLOC_REGISTRY_MAX (256u)
+#endif
+
+typedef struct allocator_snapshot {
+    const char        *name;
+    allocator_type_t   type;
+    allocator_stats_t  stats;
+} allocator_snapshot_t;
+
+size_t            allocator_registry_snapshot       (allocator_snapshot_t *out, size_t max);
+allocator_stats_t allocator_registry_aggregate      (void);
+size_t            allocator_registry_json           (allocator_writer_t *w);
+size_t            allocator_registry_openmetrics    (allocator_writer_t *w);
+/* the handler only flags the request, stdio is not async-signal-safe, so the
+ * application calls allocator_registry_poll from its own loop to dump */
+void              allocator_registry_install_signal (int signo);
+int               allocator_registry_poll           (FILE *out);
+#endif
 
 /* allocator helper macros */
 #define allocator_push_array(_a, _T, _n) (_T*)_a->alloc(_a, sizeof(_T)*(_n))
@@ -63,14 +162,68 @@ void mem_free   (allocator_t *a, void *p);
 /* arena allocator functions */
 void *allocator_arena_alloc   (allocator_t *arena, size_t size);
 void  allocator_arena_free    (allocator_t *arena, void *p);
-void *allocator_arena_realloc (allocator_t *arena, void *p);
+void *allocator_arena_realloc (allocator_t *arena, void *p, size_t old_size, size_t new_size);
 
 #endif /* ALLOC_H */
 
 
 #ifdef ALLOC_IMPL
+#ifdef ALLOC_REGISTRY
+static _Atomic(allocator_t*) allocator_registry_slots[ALLOC_REGISTRY_MAX];
+/* readers count themselves in the current phase, a removal flips the phase
+ * and only drains the readers of the old one */
+static atomic_size_t         allocator_registry_readers[2];
+static atomic_uint           allocator_registry_phase;
+static atomic_flag           allocator_registry_remove_lock = ATOMIC_FLAG_INIT;
+static volatile sig_atomic_t allocator_registry_pending;
+
+static void allocator_registry_add(allocator_t *a) {
+    for (size_t i = 0; i < ALLOC_REGISTRY_MAX; ++i) {
+        allocator_t *expected = NULL;
+        if (atomic_compare_exchange_strong(&allocator_registry_slots[i], &expected, a)) {
+            a->registry_slot = i + 1;
+            return;
+        }
+    }
+    /* registry full: the allocator works but is not reported */
+    a->registry_slot = 0;
+}
+
+static void allocator_registry_remove(allocator_t *a) {
+    if (a->registry_slot == 0) return;
+    atomic_store(&allocator_registry_slots[a->registry_slot - 1], NULL);
+    a->registry_slot = 0;
+    /* readers that loaded the pointer before the store are counted in the old
+     * phase, new readers go to the other one and can not see the pointer.
+     * Removals are serialized so the drained phase is not reused meanwhile */
+    while (atomic_flag_test_and_set(&allocator_registry_remove_lock)) {}
+    unsigned phase = atomic_fetch_xor(&allocator_registry_phase, 1u);
+    while (atomic_load(&allocator_registry_readers[phase]) != 0) {}
+    atomic_flag_clear(&allocator_registry_remove_lock);
+}
+
+/* returns the phase to pass to allocator_registry_leave */
+static unsigned allocator_registry_enter(void) {
+    for (;;) {
+        unsigned phase = atomic_load(&allocator_registry_phase);
+        atomic_fetch_add(&allocator_registry_readers[phase], 1);
+        /* a removal flipped the phase in between, it may not wait for us */
+        if (atomic_load(&allocator_registry_phase) == phase) return phase;
+        atomic_fetch_sub(&allocator_registry_readers[phase], 1);
+    }
+}
+
+static void allocator_registry_leave(unsigned phase) {
+    atomic_fetch_sub(&allocator_registry_readers[phase], 1);
+}
+#endif
+
 /* general allocator functions */
 void allocator_init(allocator_t *a, allocator_type_t type) {
+    allocator_init_named(a, type, NULL);
+}
+
+void allocator_init_named(allocator_t *a, allocator_type_t type, const char *name) {
     *a = (allocator_t){
         .stats = {
             .peak     = 0,
@@ -78,6 +231,7 @@ void allocator_init(allocator_t *a, allocator_type_t type) {
             .used     = 0,
         },
         .type = type,
+        .name = name,
     };
     switch (type) {
         case ALLOCATOR_TYPE_ARENA: {
@@ -90,9 +244,15 @@ void allocator_init(allocator_t *a, allocator_type_t type) {
         default:
         break;
     }
+#ifdef ALLOC_REGISTRY
+    allocator_registry_add(a);
+#endif
 }
 
 void allocator_deinit(allocator_t *a) {
+#ifdef ALLOC_REGISTRY
+    allocator_registry_remove(a);
+#endif
     switch (a->type) {
         case ALLOCATOR_TYPE_ARENA: {
             arena_deinit(&a->arena);
@@ -103,32 +263,369 @@ void allocator_deinit(allocator_t *a) {
     }
     /* update stats */
     {
-        a->stats.used = 0;
-        a->stats.reserved = 0;
+        allocator_stat_set(a->stats.used, 0);
+        allocator_stat_set(a->stats.reserved, 0);
     }
 }
 
+/* arenas count their blocks as they come and go, so reserved also drops
+ * when trimming frees them */
+static allocator_stats_t allocator_stats_load(const allocator_t *a) {
+    allocator_stats_t st = {
+        .used     = allocator_stat_get(a->stats.used),
+        .reserved = allocator_stat_get(a->stats.reserved),
+        .peak     = allocator_stat_get(a->stats.peak),
+    };
+    if (a->type == ALLOCATOR_TYPE_ARENA) st.reserved = allocator_stat_get(a->arena.reserved);
+    return st;
+}
+
 void allocator_dump_stats(allocator_t *a, const char* name) {
+    allocator_stats_t st = allocator_stats_load(a);
     printf("%s stats:\n", name);
-    printf("    Used     : %zu bytes\n", a->stats.used);
-    printf("    Reserved : %zu bytes\n", a->stats.reserved);
-    printf("    Peak     : %zu bytes\n", a->stats.peak);
+    printf("    Used     : %zu bytes\n", st.used);
+    printf("    Reserved : %zu bytes\n", st.reserved);
+    printf("    Peak     : %zu bytes\n", st.peak);
+}
+
+const char *allocator_type_name(allocator_type_t type) {
+    switch (type) {
+        case ALLOCATOR_TYPE_ARENA: return "arena";
+        default:                   return "unknown";
+    }
+}
+
+/* stats export functions */
+allocator_writer_t allocator_writer_file(FILE *file) {
+    return (allocator_writer_t){ .file = file };
+}
+
+allocator_writer_t allocator_writer_buffer(char *buf, size_t cap) {
+    if (cap > 0) buf[0] = '\0';
+    return (allocator_writer_t){ .buf = buf, .cap = cap };
+}
+
+void allocator_writer_printf(allocator_writer_t *w, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n;
+    if (w->file) {
+        n = vfprintf(w->file, fmt, args);
+    } else {
+        size_t room = w->cap > w->len ? w->cap - w->len : 0;
+        n = vsnprintf(room ? w->buf + w->len : NULL, room, fmt, args);
+    }
+    va_end(args);
+    if (n > 0) w->len += (size_t)n;
+}
+
+/* escapes for JSON strings and OpenMetrics label values, both accept \\ \" \n */
+static void allocator_writer_escaped(allocator_writer_t *w, const char *str) {
+    for (const char *c = str; *c; ++c) {
+        switch (*c) {
+            case '\\': allocator_writer_printf(w, "\\\\"); break;
+            case '"':  allocator_writer_printf(w, "\\\""); break;
+            case '\n': allocator_writer_printf(w, "\\n");  break;
+            default:
+                if ((unsigned char)*c < 0x20) allocator_writer_printf(w, "\\u%04x", *c);
+                else                          allocator_writer_printf(w, "%c", *c);
+        }
+    }
+}
+
+static void allocator_writer_json_string(allocator_writer_t *w, const char *str) {
+    allocator_writer_printf(w, "\"");
+    allocator_writer_escaped(w, str ? str : "");
+    allocator_writer_printf(w, "\"");
+}
+
+#ifdef ALLOC_HISTOGRAM
+/* size histogram functions */
+const allocator_histogram_t *allocator_get_histogram(allocator_t *a) {
+    return &a->histogram;
+}
+
+size_t allocator_histogram_bucket(size_t size) {
+    if (size <= ((size_t)1 << ALLOC_HISTOGRAM_LINEAR_SHIFT)) {
+        return size == 0 ? 0 : (size - 1) >> ALLOC_HISTOGRAM_STEP_SHIFT;
+    }
+    /* bit width of (size - 1) picks the power of two bucket */
+    size_t width = 64u - (size_t)__builtin_clzll((unsigned long long)(size - 1));
+    return ALLOC_HISTOGRAM_LINEAR_BUCKETS + width - ALLOC_HISTOGRAM_LINEAR_SHIFT - 1;
+}
+
+void allocator_histogram_range(size_t bucket, size_t *lo, size_t *hi) {
+    if (bucket < ALLOC_HISTOGRAM_LINEAR_BUCKETS) {
+        *lo = bucket == 0 ? 0 : (bucket << ALLOC_HISTOGRAM_STEP_SHIFT) + 1;
+        *hi = (bucket + 1) << ALLOC_HISTOGRAM_STEP_SHIFT;
+        return;
+    }
+    size_t shift = bucket - ALLOC_HISTOGRAM_LINEAR_BUCKETS + ALLOC_HISTOGRAM_LINEAR_SHIFT;
+    *lo = ((size_t)1 << shift) + 1;
+    *hi = shift + 1 >= 64 ? SIZE_MAX : (size_t)1 << (shift + 1);
+}
+
+static inline void allocator_histogram_record(allocator_t *a, size_t size) {
+    size_t bucket = allocator_histogram_bucket(size);
+    allocator_stat_set(a->histogram.count[bucket], a->histogram.count[bucket] + 1);
+    allocator_stat_set(a->histogram.bytes[bucket], a->histogram.bytes[bucket] + size);
 }
 
+static void allocator_histogram_write_json(allocator_writer_t *w, allocator_t *a) {
+    allocator_writer_printf(w, "[");
+    int first = 1;
+    for (size_t i = 0; i < ALLOC_HISTOGRAM_BUCKETS; ++i) {
+        size_t count = allocator_stat_get(a->histogram.count[i]);
+        if (count == 0) continue;
+        size_t lo, hi;
+        allocator_histogram_range(i, &lo, &hi);
+        allocator_writer_printf(w, "%s{\"lo\":%zu,\"hi\":%zu,\"count\":%zu,\"bytes\":%zu}",
+                                first ? "" : ",", lo, hi, count, allocator_stat_get(a->histogram.bytes[i]));
+        first = 0;
+    }
+    allocator_writer_printf(w, "]");
+}
+
+void allocator_dump_histogram(allocator_t *a, const char* name) {
+    printf("%s size histogram:\n", name);
+    for (size_t i = 0; i < ALLOC_HISTOGRAM_BUCKETS; ++i) {
+        if (a->histogram.count[i] == 0) continue;
+        size_t lo, hi;
+        allocator_histogram_range(i, &lo, &hi);
+        printf("    [%zu, %zu] : %zu allocs, %zu bytes\n",
+               lo, hi, a->histogram.count[i], a->histogram.bytes[i]);
+    }
+}
+
+void allocator_dump_histogram_json(allocator_t *a, const char* name, FILE *out) {
+    allocator_writer_t w = allocator_writer_file(out);
+    allocator_writer_printf(&w, "{\"name\":");
+    allocator_writer_json_string(&w, name);
+    allocator_writer_printf(&w, ",\"buckets\":");
+    allocator_histogram_write_json(&w, a);
+    allocator_writer_printf(&w, "}\n");
+}
+#endif /* ALLOC_HISTOGRAM */
+
+size_t allocator_stats_json(allocator_writer_t *w, const allocator_entry_t *entries, size_t n) {
+    size_t start = w->len;
+    allocator_writer_printf(w, "{\"allocators\":[");
+    for (size_t i = 0; i < n; ++i) {
+        const allocator_entry_t *e = &entries[i];
+        allocator_writer_printf(w, "%s{\"name\":", i ? "," : "");
+        allocator_writer_json_string(w, e->name);
+        allocator_writer_printf(w, ",\"type\":\"%s\",\"labels\":{", allocator_type_name(e->allocator->type));
+        for (size_t l = 0; e->labels && e->labels[l] && e->labels[l + 1]; l += 2) {
+            if (l) allocator_writer_printf(w, ",");
+            allocator_writer_json_string(w, e->labels[l]);
+            allocator_writer_printf(w, ":");
+            allocator_writer_json_string(w, e->labels[l + 1]);
+        }
+        allocator_stats_t st = allocator_stats_load(e->allocator);
+        allocator_writer_printf(w, "},\"used\":%zu,\"reserved\":%zu,\"peak\":%zu",
+                                st.used, st.reserved, st.peak);
+#ifdef ARENA_ADAPTIVE
+        if (e->allocator->type == ALLOCATOR_TYPE_ARENA) {
+            arena_adaptive_t *ad = &e->allocator->arena.adaptive;
+            allocator_writer_printf(w, ",\"adaptive\":{\"hwm\":%zu,\"cycles\":%zu,\"hits\":%zu,"
+                                    "\"misses\":%zu,\"consolidations\":%zu}",
+                                    allocator_stat_get(ad->hwm), allocator_stat_get(ad->cycles),
+                                    allocator_stat_get(ad->hits), allocator_stat_get(ad->misses),
+                                    allocator_stat_get(ad->consolidations));
+        }
+#endif
+#ifdef ARENA_PURGE
+        if (e->allocator->type == ALLOCATOR_TYPE_ARENA) {
+            arena_t *arena = &e->allocator->arena;
+            allocator_writer_printf(w, ",\"purge\":{\"resident\":%zu,\"purged\":%zu,\"purges\":%zu}",
+                                    arena_resident(arena), allocator_stat_get(arena->purged),
+                                    allocator_stat_get(arena->purges));
+        }
+#endif
+#ifdef ALLOC_HISTOGRAM
+        allocator_writer_printf(w, ",\"histogram\":");
+        allocator_histogram_write_json(w, e->allocator);
+#endif
+        allocator_writer_printf(w, "}");
+    }
+    allocator_writer_printf(w, "]}\n");
+    return w->len - start;
+}
+
+/* label names must match [a-zA-Z_][a-zA-Z0-9_]* and not repeat the labels
+ * written here, anything else would make the whole exposition unparseable */
+static int allocator_openmetrics_label_ok(const char *key) {
+    if (!strcmp(key, "name") || !strcmp(key, "type") || !strcmp(key, "le")) return 0;
+    for (const char *c = key; *c; ++c) {
+        int alpha = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || *c == '_';
+        if (!alpha && (c == key || *c < '0' || *c > '9')) return 0;
+    }
+    return *key != '\0';
+}
+
+/* writes '{name="...",type="...",labels...' without the closing brace, so
+ * callers can append metric specific labels such as 'le'. Invalid label
+ * keys are skipped */
+static void allocator_openmetrics_labels(allocator_writer_t *w, const allocator_entry_t *e) {
+    allocator_writer_printf(w, "{name=\"");
+    allocator_writer_escaped(w, e->name ? e->name : "");
+    allocator_writer_printf(w, "\",type=\"%s\"", allocator_type_name(e->allocator->type));
+    for (size_t l = 0; e->labels && e->labels[l] && e->labels[l + 1]; l += 2) {
+        if (!allocator_openmetrics_label_ok(e->labels[l])) continue;
+        allocator_writer_printf(w, ",%s=\"", e->labels[l]);
+        allocator_writer_escaped(w, e->labels[l + 1]);
+        allocator_writer_printf(w, "\"");
+    }
+}
+
+size_t allocator_stats_openmetrics(allocator_writer_t *w, const allocator_entry_t *entries, size_t n) {
+    static const struct {
+        const char *name, *help;
+        size_t      offset;
+    } gauges[] = {
+        { "alloc_used_bytes",     "Bytes handed out by the allocator.",         offsetof(allocator_stats_t, used)     },
+        { "alloc_reserved_bytes", "Bytes reserved from the system.",            offsetof(allocator_stats_t, reserved) },
+        { "alloc_peak_bytes",     "Highest value reached by alloc_used_bytes.", offsetof(allocator_stats_t, peak)     },
+    };
+
+    size_t start = w->len;
+    for (size_t g = 0; g < sizeof(gauges) / sizeof(gauges[0]); ++g) {
+        allocator_writer_printf(w, "# TYPE %s gauge\n# UNIT %s bytes\n# HELP %s %s\n",
+                                gauges[g].name, gauges[g].name, gauges[g].name, gauges[g].help);
+        for (size_t i = 0; i < n; ++i) {
+            allocator_stats_t st = allocator_stats_load(entries[i].allocator);
+            size_t *value = (size_t*)((char*)&st + gauges[g].offset);
+            allocator_writer_printf(w, "%s", gauges[g].name);
+            allocator_openmetrics_labels(w, &entries[i]);
+            allocator_writer_printf(w, "} %zu\n", *value);
+        }
+    }
+#ifdef ALLOC_HISTOGRAM
+    allocator_writer_printf(w, "# TYPE alloc_request_size_bytes histogram\n"
+                               "# UNIT alloc_request_size_bytes bytes\n"
+                               "# HELP alloc_request_size_bytes Requested allocation sizes.\n");
+    for (size_t i = 0; i < n; ++i) {
+        allocator_histogram_t *h = &entries[i].allocator->histogram;
+        size_t count = 0, sum = 0;
+        for (size_t b = 0; b < ALLOC_HISTOGRAM_BUCKETS; ++b) {
+            size_t bucket_count = allocator_stat_get(h->count[b]);
+            count += bucket_count;
+            sum   += allocator_stat_get(h->bytes[b]);
+            /* skip empty buckets, cumulative counts stay valid */
+            if (bucket_count == 0 || b + 1 == ALLOC_HISTOGRAM_BUCKETS) continue;
+            size_t lo, hi;
+            allocator_histogram_range(b, &lo, &hi);
+            allocator_writer_printf(w, "alloc_request_size_bytes_bucket");
+            allocator_openmetrics_labels(w, &entries[i]);
+            allocator_writer_printf(w, ",le=\"%zu\"} %zu\n", hi, count);
+        }
+        allocator_writer_printf(w, "alloc_request_size_bytes_bucket");
+        allocator_openmetrics_labels(w, &entries[i]);
+        allocator_writer_printf(w, ",le=\"+Inf\"} %zu\n", count);
+        allocator_writer_printf(w, "alloc_request_size_bytes_count");
+        allocator_openmetrics_labels(w, &entries[i]);
+        allocator_writer_printf(w, "} %zu\n", count);
+        allocator_writer_printf(w, "alloc_request_size_bytes_sum");
+        allocator_openmetrics_labels(w, &entries[i]);
+        allocator_writer_printf(w, "} %zu\n", sum);
+    }
+#endif
+    allocator_writer_printf(w, "# EOF\n");
+    return w->len - start;
+}
+
+#ifdef ALLOC_REGISTRY
+/* registry functions */
+static size_t allocator_registry_entries(allocator_entry_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < ALLOC_REGISTRY_MAX; ++i) {
+        allocator_t *a = atomic_load(&allocator_registry_slots[i]);
+        if (!a) continue;
+        out[n++] = (allocator_entry_t){
+            .allocator = a,
+            .name      = a->name ? a->name : allocator_type_name(a->type),
+        };
+    }
+    return n;
+}
+
+size_t allocator_registry_snapshot(allocator_snapshot_t *out, size_t max) {
+    allocator_entry_t entries[ALLOC_REGISTRY_MAX];
+    unsigned phase = allocator_registry_enter();
+    size_t n = allocator_registry_entries(entries);
+    for (size_t i = 0; i < n && i < max; ++i) {
+        out[i] = (allocator_snapshot_t){
+            .name  = entries[i].name,
+            .type  = entries[i].allocator->type,
+            .stats = allocator_stats_load(entries[i].allocator),
+        };
+    }
+    allocator_registry_leave(phase);
+    return n;
+}
+
+allocator_stats_t allocator_registry_aggregate(void) {
+    allocator_snapshot_t snap[ALLOC_REGISTRY_MAX];
+    size_t n = allocator_registry_snapshot(snap, ALLOC_REGISTRY_MAX);
+    allocator_stats_t total = {0};
+    for (size_t i = 0; i < n; ++i) {
+        total.used     += snap[i].stats.used;
+        total.reserved += snap[i].stats.reserved;
+        total.peak     += snap[i].stats.peak;
+    }
+    return total;
+}
+
+size_t allocator_registry_json(allocator_writer_t *w) {
+    allocator_entry_t entries[ALLOC_REGISTRY_MAX];
+    unsigned phase = allocator_registry_enter();
+    size_t len = allocator_stats_json(w, entries, allocator_registry_entries(entries));
+    allocator_registry_leave(phase);
+    return len;
+}
+
+size_t allocator_registry_openmetrics(allocator_writer_t *w) {
+    allocator_entry_t entries[ALLOC_REGISTRY_MAX];
+    unsigned phase = allocator_registry_enter();
+    size_t len = allocator_stats_openmetrics(w, entries, allocator_registry_entries(entries));
+    allocator_registry_leave(phase);
+    return len;
+}
+
+static void allocator_registry_signal_handler(int signo) {
+    (void)signo;
+    allocator_registry_pending = 1;
+}
+
+void allocator_registry_install_signal(int signo) {
+    struct sigaction sa = {0};
+    sa.sa_handler = allocator_registry_signal_handler;
+    sa.sa_flags   = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signo, &sa, NULL);
+}
+
+int allocator_registry_poll(FILE *out) {
+    if (!allocator_registry_pending) return 0;
+    allocator_registry_pending = 0;
+    allocator_writer_t w = allocator_writer_file(out);
+    allocator_registry_json(&w);
+    fflush(out);
+    return 1;
+}
+#endif /* ALLOC_REGISTRY */
+
 /* arena allocator functions */
 void *allocator_arena_alloc(allocator_t *a, size_t size) {
-    arena_block_t *end = a->arena.end;
     void *ptr = arena_alloc(&a->arena, size);
+    if (!ptr || !alloc_conf()->stats) return ptr;
 
-    /* update stats */
-    if (a->arena.end != end) {
-        /* new block allocated */
-        arena_block_t *new_end = a->arena.end;
-        size_t size_bytes = sizeof(arena_block_t) + sizeof(uint8_t) * new_end->size;
-        a->stats.reserved += size_bytes;
-    }
-    a->stats.used += size;
-    a->stats.peak = max(a->stats.peak, a->stats.used);
+    /* update stats, reserved comes from the arena */
+    allocator_stat_set(a->stats.used, a->stats.used + size);
+    allocator_stat_set(a->stats.peak, max(a->stats.peak, a->stats.used));
+#ifdef ALLOC_HISTOGRAM
+    allocator_histogram_record(a, size);
+#endif
 
     return ptr;
 }
@@ -137,16 +634,34 @@ void allocator_arena_free(allocator_t *a, void *p) {
     arena_free(&a->arena);
 }
 
-void *allocator_arena_realloc(allocator_t *a, void *p) {
-    return arena_realloc(&a->arena, p);
+void *allocator_arena_realloc(allocator_t *a, void *p, size_t old_size, size_t new_size) {
+    void *ptr = arena_realloc(&a->arena, p, old_size, new_size);
+    if (!ptr || !alloc_conf()->stats) return ptr;
+
+    /* update stats, reserved comes from the arena */
+    allocator_stat_set(a->stats.used, a->stats.used - (p ? old_size : 0) + new_size);
+    allocator_stat_set(a->stats.peak, max(a->stats.peak, a->stats.used));
+
+    return ptr;
 }
 
 void *mem_alloc(allocator_t *a, size_t size) {
     return a->alloc(a, size);
 }
 
+void *mem_calloc(allocator_t *a, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *p = a->alloc(a, count * size);
+    if (p) alloc_memzero(p, count * size);
+    return p;
+}
+
 void mem_free(allocator_t *a, void *p) {
     a->free(a, p);
 }
 
+void *mem_realloc(allocator_t *a, void *p, size_t old_size, size_t new_size) {
+    return a->realloc(a, p, old_size, new_size);
+}
+
 #endif /* ALLOC_IMPL */
@@ -6,6 +6,38 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdalign.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
+
+#include "probe.h"
+#include "poison.h"
+#ifdef ARENA_IMPL
+#define MEMOPS_IMPL
+#endif
+#include "memops.h"
+
+#ifdef ARENA_GUARDED
+#ifdef ARENA_IMPL
+#define GUARDED_IMPL
+#endif
+#include "guarded.h"
+#endif
+
+#ifdef ARENA_BUDGET
+#ifdef ARENA_IMPL
+#define ALLOC_BUDGET_IMPL
+#endif
+#include "budget.h"
+#endif
+
+#ifdef ARENA_MAPPED
+#ifdef ARENA_IMPL
+#define VMEM_IMPL
+#endif
+#include "vmem.h"
+#include "relptr.h"
+#endif
 
 /* helper macros */
 #define round_up_to_multiple(_n, _m) ({    \
@@ -25,24 +57,121 @@ typedef struct arena_block arena_block_t ;
 struct arena_block {
     arena_block_t *next;
     size_t size, used;
+#ifdef ARENA_PURGE
+    size_t dirty; /* how far the block was written since its last purge */
+#endif
     uint8_t bytes[];
 };
 
+#ifdef ARENA_CACHE
+#ifdef ARENA_IMPL
+#define ARENA_CACHE_IMPL
+#endif
+#include "arena_cache.h"
+#endif
+
+#ifdef ARENA_PRESSURE
+#ifdef ARENA_IMPL
+#define ALLOC_PRESSURE_IMPL
+#endif
+#include "pressure.h"
+#endif
+
 #ifndef ARENA_BLOCKSIZE_MIN
 #define ARENA_BLOCKSIZE_MIN  (512u)
 #endif
 #ifndef ARENA_BLOCKSIZE_MAX
 #define ARENA_BLOCKSIZE_MAX  (1u<<20)
 #endif
+#ifndef ARENA_PURGE_THRESHOLD
+#define ARENA_PURGE_THRESHOLD (64u<<10)
+#endif
+
+/* compiled block sizes are the defaults of the runtime configuration */
+#ifdef ARENA_IMPL
+#define ALLOC_CONF_IMPL
+#endif
+#include "conf.h"
+
+#ifdef ARENA_MAPPED
+/* file-backed arena: blocks are carved from a file mapped MAP_SHARED, by
+ * default at the same address on every open so absolute pointers stored in the
+ * arena stay valid. With ARENA_MAP_RELOCATE the file may be mapped anywhere,
+ * the arena then only fixes its own block list and the user data must use
+ * relptr_t/offptr_t (relptr.h) instead of absolute pointers.
+ * The header at offset 0 keeps the block list and bump state. */
+#define ARENA_MAP_MAGIC   (0x70616d616e657261ull) /* "arenamap" */
+#define ARENA_MAP_VERSION (2u)
+
+enum {
+    ARENA_MAP_POPULATE = VMEM_POPULATE,
+    ARENA_MAP_WILLNEED = VMEM_WILLNEED,
+    ARENA_MAP_RELOCATE = 1 << 8, /* map anywhere if the original address is taken */
+};
+
+typedef struct arena_map_header {
+    uint64_t       magic, version;
+    uint64_t       base, reserved; /* address and size of the reservation */
+    uint64_t       top;            /* file bytes handed out so far */
+    uint64_t       block_seq;
+    arena_block_t *start, *end;
+    offptr_t       root;           /* entry point to the user data */
+} arena_map_header_t;
+#endif
+
+#ifdef ARENA_ADAPTIVE
+/* adaptive sizing: arena_reset keeps a high-water mark of the bytes used per
+ * reset cycle, decayed by 1/2^ARENA_ADAPTIVE_DECAY of the gap per cycle, and
+ * consolidates the block list into one block of that size. In steady state
+ * every cycle then runs in a single block. A cycle counts as a hit when it
+ * fit in the block prepared by the previous reset. */
+#ifndef ARENA_ADAPTIVE_DECAY
+#define ARENA_ADAPTIVE_DECAY (3u)
+#endif
+
+typedef struct arena_adaptive {
+    size_t hwm;        /* decayed high-water mark in bytes */
+    size_t cycle_peak; /* largest usage seen by arena_rewind this cycle */
+    size_t predicted;  /* size of the block prepared by the last reset, 0 for none */
+    size_t cycles, hits, misses, consolidations;
+} arena_adaptive_t;
+#endif
 
 typedef struct arena {
     arena_block_t *start, *end;
+    arena_block_t *inline_block; /* caller owned first block, never freed */
+    int append;                  /* allocate in block order only, see arena_set_append */
     size_t block_seq;
+    size_t reserved; /* bytes of the blocks held now, headers included */
+#ifdef ARENA_ADAPTIVE
+    arena_adaptive_t adaptive;
+#endif
+#ifdef ARENA_BUDGET
+    alloc_budget_t *budget; /* charged for every heap block, NULL for none */
+#endif
+#ifdef ARENA_PRESSURE
+    uint64_t pressure_epoch; /* last alloc_pressure_epoch this arena trimmed for */
+#endif
+#ifdef ARENA_PURGE
+    size_t purged, purges;   /* bytes handed back with madvise and the calls doing it */
+    size_t resident;         /* sum of the blocks' dirty marks */
+#endif
+#ifdef ARENA_GUARDED
+    uint64_t guarded_seq;  /* orders sampled allocations against markers */
+    size_t   guarded_live; /* sampled slots not released yet */
+#endif
+#ifdef ARENA_MAPPED
+    vmem_t              map;
+    arena_map_header_t *map_header; /* NULL for heap backed arenas */
+#endif
 } arena_t;
 
 typedef struct arena_marker {
     arena_block_t *block;
     size_t offset;
+#ifdef ARENA_GUARDED
+    uint64_t guarded_seq;
+#endif
 } arena_marker_t;
 
 typedef struct arena_temp {
@@ -50,80 +179,458 @@ typedef struct arena_temp {
     arena_t *arena;
 } arena_temp_t;
 
+/* where arena_flatten moved each block's contents */
+typedef struct arena_reloc_range {
+    uint8_t *old_start, *new_start;
+    size_t   len;
+} arena_reloc_range_t;
+
+typedef struct arena_reloc {
+    const arena_reloc_range_t *ranges;
+    size_t                     count;
+} arena_reloc_t;
+
+typedef void (*arena_reloc_fn)(void *ctx, const arena_reloc_t *reloc);
+
 void          *arena_alloc          (arena_t *arena, size_t size);
+void          *arena_calloc         (arena_t *arena, size_t count, size_t size);
+void          *arena_alloc_bytes    (arena_t *arena, size_t size);
+void           arena_set_append     (arena_t *arena, int append);
 void           arena_free           (arena_t *arena);
-void          *arena_realloc        (arena_t *arena, void *p);
+void          *arena_realloc        (arena_t *arena, void *p, size_t old_size, size_t new_size);
+int            arena_resize         (arena_t *arena, void *p, size_t old_size, size_t new_size);
 void           arena_init           (arena_t *arena);
+void           arena_init_inline    (arena_t *arena, void *buf, size_t size);
 void           arena_deinit         (arena_t *arena);
 void           arena_reset          (arena_t *arena);
 arena_marker_t arena_snapshot       (arena_t *arena);
 void           arena_rewind         (arena_t *arena, arena_marker_t m);
 arena_temp_t   arena_scratch_init   (arena_t *arena);
 void           arena_scratch_deinit (arena_temp_t scratch);
+size_t         arena_flatten        (arena_t *arena, arena_reloc_fn fn, void *ctx);
+size_t         arena_trim           (arena_t *arena);
+#ifdef ARENA_PURGE
+/* page purging: when reset or rewind leaves at least the purge threshold of
+ * written bytes behind in a block, the whole pages among them are given back
+ * with madvise(ARENA_PURGE_ADVICE). The blocks and their address ranges stay,
+ * so reuse needs no new allocation, only fresh page faults.
+ * With ARENA_MAPPED the block header differs, files are not interchangeable
+ * between builds with and without ARENA_PURGE; mapped arenas are not purged.
+ * arena_purge purges every block now, whatever the threshold, and
+ * arena_resident estimates the written bytes that are still resident. The
+ * counters are kept up to date by the arena, so stats exporters on other
+ * threads read them without walking the block list */
+size_t         arena_purge          (arena_t *arena);
+size_t         arena_resident       (arena_t *arena);
+#endif
+void          *arena_reloc_ptr      (const arena_reloc_t *reloc, const void *old);
+#ifdef ARENA_BUDGET
+/* set before the first allocation, blocks are released to the budget they were charged to */
+void           arena_set_budget     (arena_t *arena, alloc_budget_t *budget);
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+size_t         arena_to_iovec       (arena_t *arena, arena_marker_t from, struct iovec *iov, size_t max);
+#endif
+
+/* arena with an inline first block, like SmallVector: allocations that fit in
+ * the storage need no heap memory, larger ones spill into regular blocks.
+ * The struct points into itself, so it must not be copied or moved.
+ *
+ *   ARENA_INLINE_DEFINE(scratch, 256)
+ *   scratch_t s;
+ *   arena_t *arena = scratch_init(&s);
+ *   ...
+ *   arena_deinit(arena);
+ */
+#define ARENA_INLINE_DEFINE(_name, _bytes)                                      \
+typedef struct _name {                                                          \
+    arena_t arena;                                                              \
+    alignas(max_align_t) uint8_t storage[sizeof(arena_block_t) + (_bytes)];     \
+} _name##_t;                                                                    \
+                                                                                \
+static inline arena_t *_name##_init(_name##_t *s) {                             \
+    arena_init_inline(&s->arena, s->storage, sizeof(s->storage));               \
+    return &s->arena;                                                           \
+}
+
+#ifdef ARENA_MAPPED
+/* mapped arena functions, return 0 on success and -1 with errno set.
+ * arena_deinit syncs and unmaps a mapped arena, the file keeps its contents */
+int            arena_map_create     (arena_t *arena, const char *path, size_t reserve, int flags);
+int            arena_map_open       (arena_t *arena, const char *path, int flags);
+int            arena_map_sync       (arena_t *arena);
+void          *arena_map_root       (arena_t *arena);
+void           arena_map_set_root   (arena_t *arena, void *root);
+
+/* base-relative addressing inside a mapped arena */
+#define arena_base(_arena)            ((void*)(_arena)->map.base)
+#define arena_to_off(_arena, _p)      offptr_encode(arena_base(_arena), (_p))
+#define arena_from_off(_arena, _T, _o) offptr_get(_T, arena_base(_arena), (_o))
+#endif
 
 #endif /* ARENA_H */
 
 
-#ifdef ARENA_IMPL
+/* containers include arena.h too, emit the implementation only once */
+#if defined(ARENA_IMPL) && !defined(ARENA_IMPL_DONE)
+#define ARENA_IMPL_DONE
+
+#include <string.h>
+
+/* single writer counters, stored relaxed for stats readers on other threads */
+#define arena_counter_add(_c, _d) __atomic_store_n(&(_c), (_c) + (_d), __ATOMIC_RELAXED)
+#define arena_counter_sub(_c, _d) __atomic_store_n(&(_c), (_c) - (_d), __ATOMIC_RELAXED)
 
-static arena_block_t *arena_block_alloc(size_t size) {
+#ifdef ARENA_PURGE
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* call after raising and before lowering b->used, remembers how far the block
+ * was written. Keeps dirty >= used, so arena->resident covers every byte */
+static void arena_block_mark(arena_t *arena, arena_block_t *b) {
+    if (b->used <= b->dirty) return;
+    arena_counter_add(arena->resident, b->used - b->dirty);
+    b->dirty = b->used;
+}
+#endif
+
+#ifdef ARENA_MAPPED
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static arena_block_t *arena_map_block_alloc(arena_t *arena, size_t size) {
+    arena_map_header_t *h = arena->map_header;
+    size_t at  = round_up_to_multiple((size_t)h->top, MAX_ALIGN);
+    size_t end = at + sizeof(arena_block_t) + size;
+    if (vmem_commit(&arena->map, end) != 0) return NULL;
+    h->top = end;
+
+    /* fresh file pages read as zero */
+    arena_block_t *block = (arena_block_t*)(arena->map.base + at);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+#ifdef ARENA_PURGE
+    block->dirty = 0;
+#endif
+    ALLOC_POISON(block->bytes, size);
+    return block;
+}
+
+int arena_map_create(arena_t *arena, const char *path, size_t reserve, int flags) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    arena_init(arena);
+    if (vmem_reserve(&arena->map, sizeof(arena_map_header_t) + reserve, fd, NULL, flags) != 0 ||
+        vmem_commit(&arena->map, sizeof(arena_map_header_t)) != 0) {
+        int err = errno;
+        vmem_release(&arena->map);
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    arena_map_header_t *h = (arena_map_header_t*)arena->map.base;
+    *h = (arena_map_header_t){
+        .magic    = ARENA_MAP_MAGIC,
+        .version  = ARENA_MAP_VERSION,
+        .base     = (uint64_t)(uintptr_t)arena->map.base,
+        .reserved = arena->map.reserved,
+        .top      = sizeof(arena_map_header_t),
+    };
+    arena->map_header = h;
+    return 0;
+}
+
+int arena_map_open(arena_t *arena, const char *path, int flags) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+
+    arena_map_header_t h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        h.magic != ARENA_MAP_MAGIC || h.version != ARENA_MAP_VERSION) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* the stored pointers are only valid at the original address */
+    arena_init(arena);
+    int vm_flags = flags & (VMEM_POPULATE | VMEM_WILLNEED);
+    if (vmem_reserve(&arena->map, h.reserved, fd, (void*)(uintptr_t)h.base, vm_flags | VMEM_FIXED) != 0 &&
+        (!(flags & ARENA_MAP_RELOCATE) || vmem_reserve(&arena->map, h.reserved, fd, NULL, vm_flags) != 0)) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    arena_map_header_t *mh = (arena_map_header_t*)arena->map.base;
+    uintptr_t delta = (uintptr_t)arena->map.base - (uintptr_t)h.base;
+    if (delta != 0) {
+        /* moved: rebase the block list, user data is position independent */
+        #define arena_rebase(_p) ((_p) = (_p) ? (arena_block_t*)((uintptr_t)(_p) + delta) : NULL)
+        arena_rebase(mh->start);
+        arena_rebase(mh->end);
+        for (arena_block_t *b = mh->start; b != NULL; b = b->next) {
+            arena_rebase(b->next);
+        }
+        #undef arena_rebase
+        mh->base = (uint64_t)(uintptr_t)arena->map.base;
+    }
+
+    arena->map_header = mh;
+    arena->start      = mh->start;
+    arena->end        = mh->end;
+    arena->block_seq  = mh->block_seq;
+    for (arena_block_t *b = arena->start; b != NULL; b = b->next) {
+        arena_counter_add(arena->reserved, sizeof(arena_block_t) + b->size);
+#ifdef ARENA_PURGE
+        arena_counter_add(arena->resident, b->dirty);
+        arena_block_mark(arena, b);
+#endif
+    }
+    return 0;
+}
+
+int arena_map_sync(arena_t *arena) {
+    arena_map_header_t *h = arena->map_header;
+    h->start     = arena->start;
+    h->end       = arena->end;
+    h->block_seq = arena->block_seq;
+    return vmem_sync(&arena->map);
+}
+
+void *arena_map_root(arena_t *arena) {
+    return offptr_decode(arena->map.base, arena->map_header->root);
+}
+
+void arena_map_set_root(arena_t *arena, void *root) {
+    arena->map_header->root = offptr_encode(arena->map.base, root);
+}
+
+static void arena_map_close(arena_t *arena) {
+    arena_map_sync(arena);
+    int fd = arena->map.fd;
+    vmem_release(&arena->map);
+    close(fd);
+    arena_init(arena);
+}
+#endif /* ARENA_MAPPED */
+
+static arena_block_t *arena_block_alloc(arena_t *arena, size_t size) {
+#ifdef ARENA_MAPPED
+    if (arena->map_header) {
+        arena_block_t *block = arena_map_block_alloc(arena, size);
+        if (block) arena_counter_add(arena->reserved, sizeof(arena_block_t) + block->size);
+        return block;
+    }
+#endif
+    arena_block_t *block = NULL;
+#ifdef ARENA_CACHE
+    block = arena_cache_take(size);
+    if (block) size = block->size;
+#endif
     size_t size_bytes = sizeof(arena_block_t) + sizeof(uint8_t) * size;
-    arena_block_t *block = (arena_block_t*)calloc(1, size_bytes);
-    assert(block != NULL);
+#ifdef ARENA_BUDGET
+    if (arena->budget && alloc_budget_charge(arena->budget, size_bytes) != 0) {
+#ifdef ARENA_CACHE
+        if (block && !arena_cache_put(block)) {
+            ALLOC_UNPOISON(block->bytes, block->size);
+            free(block);
+        }
+#endif
+        return NULL;
+    }
+#else
+    (void)arena;
+#endif
+    int zero = alloc_conf()->zero_blocks;
+    if (block) {
+        /* cached blocks are dirty */
+        if (zero) {
+            ALLOC_UNPOISON(block->bytes, size);
+            alloc_memzero(block->bytes, size);
+#ifdef ARENA_PURGE
+            block->dirty = size;
+#endif
+        }
+    } else {
+        block = zero ? (arena_block_t*)calloc(1, size_bytes) : (arena_block_t*)malloc(size_bytes);
+#ifdef ARENA_PURGE
+        if (block) block->dirty = 0;
+#endif
+    }
+    if (block == NULL) {
+#ifdef ARENA_BUDGET
+        if (arena->budget) alloc_budget_release(arena->budget, size_bytes);
+#endif
+        return NULL;
+    }
 
     block->next = NULL;
     block->size = size;
     block->used = 0;
+    ALLOC_POISON(block->bytes, size);
+    arena_counter_add(arena->reserved, size_bytes);
+#ifdef ARENA_PURGE
+    arena_counter_add(arena->resident, block->dirty);
+#endif
     return block;
 }
 
-static void arena_block_free(arena_block_t* block) {
+/* cache says whether the block may go to the block cache instead of libc */
+static void arena_block_release(arena_t *arena, arena_block_t* block, int cache) {
     assert(block != NULL);
+#ifdef ARENA_PURGE
+    arena_block_mark(arena, block);
+    arena_counter_sub(arena->resident, block->dirty);
+#endif
+    if (block == arena->inline_block) {
+        ALLOC_POISON(block->bytes, block->size);
+        return;
+    }
+    arena_counter_sub(arena->reserved, sizeof(arena_block_t) + block->size);
+#ifdef ARENA_BUDGET
+    if (arena->budget) alloc_budget_release(arena->budget, sizeof(arena_block_t) + block->size);
+#endif
+#ifdef ARENA_CACHE
+    /* the next owner inherits the written pages through block->dirty,
+     * it stays poisoned while cached */
+    ALLOC_POISON(block->bytes, block->size);
+    if (cache && arena_cache_put(block)) return;
+#else
+    (void)cache;
+#endif
+    ALLOC_UNPOISON(block->bytes, block->size);
     free(block);
 }
 
+static void arena_block_free(arena_t *arena, arena_block_t* block) {
+    arena_block_release(arena, block, 1);
+}
+
+#ifdef ARENA_GUARDED
+/* arenas that never sampled do not touch the shared slot pool */
+static void arena_guarded_release(arena_t *arena, uint64_t from_seq) {
+    if (arena->guarded_live == 0) return;
+    arena->guarded_live -= guarded_release(arena, from_seq);
+}
+#endif
+
 void arena_init(arena_t *arena) {
-    arena->block_seq = 0;
-    arena->start     = NULL;
-    arena->end       = arena->start;
+    arena->block_seq    = 0;
+    arena->reserved     = 0;
+    arena->start        = NULL;
+    arena->end          = arena->start;
+    arena->inline_block = NULL;
+    arena->append       = 0;
+#ifdef ARENA_ADAPTIVE
+    arena->adaptive     = (arena_adaptive_t){0};
+#endif
+#ifdef ARENA_BUDGET
+    arena->budget       = NULL;
+#endif
+#ifdef ARENA_PURGE
+    arena->purged       = 0;
+    arena->purges       = 0;
+    arena->resident     = 0;
+#endif
+#ifdef ARENA_PRESSURE
+    arena->pressure_epoch = alloc_pressure_epoch();
+#endif
+#ifdef ARENA_GUARDED
+    arena->guarded_seq  = 0;
+    arena->guarded_live = 0;
+#endif
+#ifdef ARENA_MAPPED
+    arena->map        = (vmem_t){ .fd = -1 };
+    arena->map_header = NULL;
+#endif
+}
+
+/* buf needs room for the block header, smaller buffers give a plain arena */
+void arena_init_inline(arena_t *arena, void *buf, size_t size) {
+    arena_init(arena);
+    uintptr_t at  = round_up_to_multiple((uintptr_t)buf, (uintptr_t)MAX_ALIGN);
+    size_t    pad = (size_t)(at - (uintptr_t)buf);
+    if (size < pad + sizeof(arena_block_t) + MAX_ALIGN) return;
+
+    arena_block_t *block = (arena_block_t*)at;
+    block->next = NULL;
+    block->size = (size - pad - sizeof(arena_block_t)) & ~(MAX_ALIGN - 1);
+    block->used = 0;
+#ifdef ARENA_PURGE
+    block->dirty = 0;
+#endif
+    ALLOC_POISON(block->bytes, block->size);
+    arena->start        = block;
+    arena->end          = block;
+    arena->inline_block = block;
 }
 
 void arena_deinit(arena_t *arena) {
+#ifdef ARENA_GUARDED
+    arena_guarded_release(arena, 0);
+#endif
+#ifdef ARENA_MAPPED
+    if (arena->map_header) {
+        /* blocks live in the file, keep them */
+        arena_map_close(arena);
+        return;
+    }
+#endif
     arena_block_t *block = arena->start;
     while (block != NULL) {
         arena_block_t *next = block->next;
-        arena_block_free(block);
+        ALLOC_PROBE3(block_release, arena, block, block->size);
+        arena_block_free(arena, block);
         block = next;
     }
 
-    arena->start = NULL;
-    arena->block_seq = 0;
+    /* the caller may drop the inline buffer now, a reused arena starts plain */
+    arena->start        = NULL;
+    arena->end          = NULL;
+    arena->inline_block = NULL;
+    arena->block_seq    = 0;
 }
 
-void *arena_alloc(arena_t *arena, size_t size) {
-    size = round_up_to_multiple(size, MAX_ALIGN);
-    arena_block_t *block = arena->start;
+/* power of two alignment, the hot path can not afford the division */
+#define arena_align_up(_n, _a) (((_n) + (_a) - 1) & ~((_a) - 1))
+
+/* takes 'size' bytes at the next 'align' boundary of the first block with
+ * room, 'request' of them are unpoisoned */
+static void *arena_bump(arena_t *arena, size_t request, size_t size, size_t align) {
+    /* append mode never goes back to blocks before 'end' */
+    arena_block_t *block = arena->append && arena->end ? arena->end : arena->start;
+    int past_end = 0;
     while (block) {
-        if (size + block->used <= block->size) {
+        if (arena_align_up(block->used, align) + size <= block->size) {
             /* found block that can hold the memory */
             /* this helps not to allocate more blocks for small allocations */
             break;
         }
+        past_end |= block == arena->end;
         block = block->next;
     }
+    /* blocks kept by reset/rewind sit past 'end', markers must cover them */
+    if (block && past_end) arena->end = block;
 
     /* did not find a suitable block */
     if (!block) {
         /* from https://github.com/nothings/stb/blob/master/stb_ds.h */
         // compute the next blocksize
+        const alloc_conf_t *conf = alloc_conf();
         size_t blocksize = arena->block_seq;
 
         // size is 512, 512, 1024, 1024, 2048, 2048, 4096, 4096, etc., so that
         // there are log(SIZE) allocations to free when we destroy the table
-        blocksize = (size_t) (ARENA_BLOCKSIZE_MIN) << (blocksize>>1);
+        blocksize = conf->block_min << (blocksize>>1);
 
         // if size is under 1M, advance to next blocktype
-        if (blocksize < (size_t)(ARENA_BLOCKSIZE_MAX))
+        if (blocksize < conf->block_max)
           ++arena->block_seq;
         /*************************************************************/
 
@@ -132,10 +639,12 @@ void *arena_alloc(arena_t *arena, size_t size) {
             /* if the requested size is greater than the current blocksize
              * just allocate the whole size, eventually the blocksize will grow
              * to handle such sizes */
-            block = arena_block_alloc(size);
+            block = arena_block_alloc(arena, size);
         } else {
-            block = arena_block_alloc(blocksize);
+            block = arena_block_alloc(arena, blocksize);
         }
+        if (!block) return NULL;
+        ALLOC_PROBE3(block_acquire, arena, block, block->size);
 
         /* push it to the back of block list */
         if (!arena->start) {
@@ -149,26 +658,286 @@ void *arena_alloc(arena_t *arena, size_t size) {
 
     }
 
-    void *ptr = &block->bytes[block->used];
-    block->used += size;
+    /* packed allocations leave 'used' unaligned */
+    void *ptr = &block->bytes[arena_align_up(block->used, align)];
+    block->used = (size_t)((uint8_t*)ptr - block->bytes) + size;
+#ifdef ARENA_PURGE
+    arena_block_mark(arena, block);
+#endif
+    ALLOC_UNPOISON(ptr, request);
+    ALLOC_PROBE3(alloc, arena, ptr, size);
 
     return ptr;
 }
 
+void *arena_alloc(arena_t *arena, size_t size) {
+    size_t request = size;
+    size = round_up_to_multiple(size, MAX_ALIGN) + ALLOC_REDZONE;
+#ifdef ARENA_GUARDED
+    /* guarded slots are not part of the file, nor of an append mode export */
+#ifdef ARENA_MAPPED
+    if (!arena->map_header && !arena->append && guarded_should_sample()) {
+#else
+    if (!arena->append && guarded_should_sample()) {
+#endif
+        void *guarded_ptr = guarded_alloc(arena, arena->guarded_seq, size - ALLOC_REDZONE);
+        if (guarded_ptr) {
+            arena->guarded_seq++;
+            arena->guarded_live++;
+            ALLOC_PROBE3(alloc, arena, guarded_ptr, size);
+            return guarded_ptr;
+        }
+    }
+#endif
+    return arena_bump(arena, request, size, MAX_ALIGN);
+}
+
+/* no alignment, no rounding and no redzone: consecutive calls in append mode
+ * lay the bytes out back to back, as arena_to_iovec exports them. The result
+ * can not be resized in place, arena_realloc copies it */
+void *arena_alloc_bytes(arena_t *arena, size_t size) {
+    return arena_bump(arena, size, size, 1);
+}
+
+/* blocks are recycled by reset and rewind, so the memory is cleared here */
+void *arena_calloc(arena_t *arena, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *p = arena_alloc(arena, count * size);
+    if (p) alloc_memzero(p, count * size);
+    return p;
+}
+
+/* in append mode arena_alloc only uses the current block and the ones after
+ * it, never an earlier block with room left, and does not sample guarded
+ * slots. Allocation order then matches block order, which arena_to_iovec
+ * relies on. Rewind and reset work as usual */
+void arena_set_append(arena_t *arena, int append) {
+    arena->append = append;
+}
+
+#ifdef ARENA_BUDGET
+void arena_set_budget(arena_t *arena, alloc_budget_t *budget) {
+    /* no heap block yet, the inline block is not charged */
+    assert(arena->start == arena->inline_block && (!arena->start || !arena->start->next));
+    arena->budget = budget;
+}
+#endif
+
 void arena_free(arena_t *arena) {
     /* NO-OP */
+    ALLOC_PROBE1(free, arena);
 }
 
-void *arena_realloc(arena_t *arena, void *p) {
-    /* NO-OP */
-    return p;
+/* block whose used range ends right after the allocation [p, p + size) */
+static arena_block_t *arena_block_top(arena_t *arena, void *p, size_t size) {
+    uint8_t *begin = (uint8_t*)p;
+    uint8_t *end   = begin + round_up_to_multiple(size, MAX_ALIGN) + ALLOC_REDZONE;
+    #define arena_block_is_top(_b) (begin >= (_b)->bytes && end == &(_b)->bytes[(_b)->used])
+    /* the current block is the usual case */
+    if (arena->end && arena_block_is_top(arena->end)) return arena->end;
+    for (arena_block_t *b = arena->start; b != NULL; b = b->next) {
+        if (arena_block_is_top(b)) return b;
+    }
+    #undef arena_block_is_top
+    return NULL;
 }
 
+/* grows or shrinks the allocation in place, only possible for the last
+ * allocation of its block. Returns 1 on success, 0 if nothing changed */
+int arena_resize(arena_t *arena, void *p, size_t old_size, size_t new_size) {
+    if (p == NULL) return 0;
+    arena_block_t *block = arena_block_top(arena, p, old_size);
+    if (!block) return 0;
+
+    size_t start = (size_t)((uint8_t*)p - block->bytes);
+    size_t used  = start + round_up_to_multiple(new_size, MAX_ALIGN) + ALLOC_REDZONE;
+    if (used > block->size) return 0;
+
+    ALLOC_POISON(&block->bytes[start], block->size - start);
+    ALLOC_UNPOISON(p, new_size);
+#ifdef ARENA_PURGE
+    /* a shrink must not forget the bytes written past the new end */
+    arena_block_mark(arena, block);
+#endif
+    block->used = used;
+#ifdef ARENA_PURGE
+    arena_block_mark(arena, block);
+#endif
+    return 1;
+}
+
+/* resizes in place when the allocation is on top of its block, otherwise
+ * allocates a new one and copies, the old memory stays in the arena */
+void *arena_realloc(arena_t *arena, void *p, size_t old_size, size_t new_size) {
+    ALLOC_PROBE3(realloc, arena, p, new_size);
+    if (p == NULL) return arena_alloc(arena, new_size);
+    if (arena_resize(arena, p, old_size, new_size)) return p;
+    if (new_size <= old_size) return p;
+
+    void *q = arena_alloc(arena, new_size);
+    if (!q) return NULL;
+    ALLOC_PROBE3(realloc_copy, arena, p, old_size);
+    alloc_memcpy(q, p, old_size);
+    return q;
+}
+
+#ifdef ARENA_PURGE
+#ifndef ARENA_PURGE_ADVICE
+#ifdef MADV_FREE
+#define ARENA_PURGE_ADVICE MADV_FREE
+#else
+#define ARENA_PURGE_ADVICE MADV_DONTNEED
+#endif
+#endif
+
+/* madvises the whole pages between used and dirty once there are at least
+ * 'threshold' such bytes, returns the bytes purged */
+static size_t arena_block_purge(arena_t *arena, arena_block_t *b, size_t threshold) {
+    if (b == arena->inline_block || b->dirty <= b->used) return 0;
+#ifdef ARENA_MAPPED
+    if (arena->map_header) return 0;
+#endif
+    if (b->dirty - b->used < max(threshold, (size_t)1)) return 0;
+
+    static size_t page;
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t lo = round_up_to_multiple((uintptr_t)&b->bytes[b->used], (uintptr_t)page);
+    uintptr_t hi = (uintptr_t)&b->bytes[b->dirty] & ~(uintptr_t)(page - 1);
+    if (hi <= lo || madvise((void*)lo, hi - lo, ARENA_PURGE_ADVICE) != 0) return 0;
+
+    size_t dirty = (size_t)(lo - (uintptr_t)b->bytes);
+    arena_counter_sub(arena->resident, b->dirty - dirty);
+    arena_counter_add(arena->purged, hi - lo);
+    arena_counter_add(arena->purges, 1);
+    b->dirty = dirty;
+    return hi - lo;
+}
+
+size_t arena_purge(arena_t *arena) {
+    size_t purged = 0;
+    for (arena_block_t *b = arena->start; b != NULL; b = b->next) {
+        arena_block_mark(arena, b);
+        purged += arena_block_purge(arena, b, 0);
+    }
+    return purged;
+}
+
+size_t arena_resident(arena_t *arena) {
+    return __atomic_load_n(&arena->resident, __ATOMIC_RELAXED);
+}
+#endif
+
+/* frees the empty blocks past the current end straight to libc, bypassing the
+ * block cache, and returns the bytes released */
+size_t arena_trim(arena_t *arena) {
+#ifdef ARENA_MAPPED
+    if (arena->map_header) return 0;
+#endif
+    if (arena->end == NULL) return 0;
+    size_t freed = 0;
+    arena_block_t **link = &arena->end->next;
+    while (*link) {
+        arena_block_t *b = *link;
+        if (b->used != 0 || b == arena->inline_block) {
+            link = &b->next;
+            continue;
+        }
+        *link  = b->next;
+        freed += sizeof(arena_block_t) + b->size;
+        ALLOC_PROBE3(block_release, arena, b, b->size);
+        arena_block_release(arena, b, 0);
+    }
+    return freed;
+}
+
+#ifdef ARENA_PRESSURE
+/* trims once per pressure event, when the arena next gives memory back */
+static void arena_pressure_check(arena_t *arena) {
+    uint64_t epoch = alloc_pressure_epoch();
+    if (arena->pressure_epoch == epoch) return;
+    arena->pressure_epoch = epoch;
+    arena_trim(arena);
+#ifdef ARENA_PURGE
+    arena_purge(arena);
+#endif
+}
+#endif
+
+#ifdef ARENA_ADAPTIVE
+static size_t arena_usage(arena_t *arena) {
+    size_t used = 0;
+    for (arena_block_t *b = arena->start; b != NULL; b = b->next) used += b->used;
+    return used;
+}
+
+/* runs before arena_reset clears the blocks */
+static void arena_adapt(arena_t *arena) {
+#ifdef ARENA_MAPPED
+    if (arena->map_header) return;
+#endif
+    /* the inline block already makes small cycles allocation free */
+    if (arena->inline_block) return;
+    arena_adaptive_t *ad = &arena->adaptive;
+    size_t peak = max(ad->cycle_peak, arena_usage(arena));
+    ad->cycle_peak = 0;
+    if (arena->start == NULL) return;
+
+    int single = arena->start->next == NULL;
+    arena_counter_add(ad->cycles, 1);
+    if (ad->predicted) {
+        if (single) arena_counter_add(ad->hits, 1);
+        else        arena_counter_add(ad->misses, 1);
+    }
+    if (peak >= ad->hwm) arena_counter_add(ad->hwm, peak - ad->hwm);
+    else                 arena_counter_sub(ad->hwm, (ad->hwm - peak) >> ARENA_ADAPTIVE_DECAY);
+
+    /* keep a single block unless the mark decayed below half of it */
+    size_t target = round_up_to_multiple(max(ad->hwm, alloc_conf()->block_min), MAX_ALIGN);
+    if (single && arena->start->size >= target && arena->start->size / 2 <= target) {
+        ad->predicted = arena->start->size;
+        return;
+    }
+
+    /* free first so the old chain and the new block never coexist */
+    for (arena_block_t *b = arena->start, *next; b != NULL; b = next) {
+        next = b->next;
+        ALLOC_PROBE3(block_release, arena, b, b->size);
+        arena_block_free(arena, b);
+    }
+    arena_block_t *block = arena_block_alloc(arena, target);
+    if (block) ALLOC_PROBE3(block_acquire, arena, block, block->size);
+    arena->start  = block;
+    arena->end    = block;
+    ad->predicted = block ? target : 0;
+    arena_counter_add(ad->consolidations, 1);
+}
+#endif
+
 void arena_reset(arena_t *arena) {
+    ALLOC_PROBE1(reset, arena);
+#ifdef ARENA_GUARDED
+    arena_guarded_release(arena, 0);
+#endif
+#ifdef ARENA_ADAPTIVE
+    arena_adapt(arena);
+#endif
+#ifdef ARENA_PURGE
+    size_t threshold = alloc_conf()->purge_threshold;
+#endif
     for (arena_block_t* b = arena->start; b != NULL; b = b->next) {
+#ifdef ARENA_PURGE
+        arena_block_mark(arena, b);
+#endif
         b->used = 0;
+        ALLOC_POISON(b->bytes, b->size);
+#ifdef ARENA_PURGE
+        arena_block_purge(arena, b, threshold);
+#endif
     }
     arena->end = arena->start;
+#ifdef ARENA_PRESSURE
+    arena_pressure_check(arena);
+#endif
 }
 
 arena_marker_t arena_snapshot(arena_t *arena) {
@@ -180,20 +949,49 @@ arena_marker_t arena_snapshot(arena_t *arena) {
         m.block = arena->end;
         m.offset = arena->end->used;
     }
+#ifdef ARENA_GUARDED
+    m.guarded_seq = arena->guarded_seq;
+#endif
 
     return m;
 }
 
 void arena_rewind(arena_t *arena, arena_marker_t m) {
+    ALLOC_PROBE3(rewind, arena, m.block, m.offset);
     if (m.block == NULL) {
         arena_reset(arena);
         return;
     }
+#ifdef ARENA_GUARDED
+    arena_guarded_release(arena, m.guarded_seq);
+#endif
+#ifdef ARENA_ADAPTIVE
+    /* usage rewound here never reaches arena_reset, remember the peak */
+    arena->adaptive.cycle_peak = max(arena->adaptive.cycle_peak, arena_usage(arena));
+#endif
+#ifdef ARENA_PURGE
+    size_t threshold = alloc_conf()->purge_threshold;
+    arena_block_mark(arena, m.block);
+#endif
     m.block->used = m.offset;
+    ALLOC_POISON(&m.block->bytes[m.offset], m.block->size - m.offset);
+#ifdef ARENA_PURGE
+    arena_block_purge(arena, m.block, threshold);
+#endif
     for (arena_block_t *b = m.block->next; b != NULL; b = b->next) {
+#ifdef ARENA_PURGE
+        arena_block_mark(arena, b);
+#endif
         b->used = 0;
+        ALLOC_POISON(b->bytes, b->size);
+#ifdef ARENA_PURGE
+        arena_block_purge(arena, b, threshold);
+#endif
     }
     arena->end = m.block;
+#ifdef ARENA_PRESSURE
+    arena_pressure_check(arena);
+#endif
 }
 
 arena_temp_t arena_scratch_init(arena_t *arena) {
@@ -209,4 +1007,118 @@ void arena_scratch_deinit(arena_temp_t scratch) {
     arena_rewind(scratch.arena, scratch.marker);
 }
 
+/* copies the used part of every block, in block order, into a single block
+ * and frees the old ones. 'fn' (optional) runs after the copy while the old
+ * blocks are still readable, and can fix up pointers in the new copy with
+ * arena_reloc_ptr. Markers taken before are invalidated. Mapped arenas can not
+ * give file space back and are left alone, an inline first block stays in
+ * place and only the heap blocks behind it are flattened. Returns the heap
+ * bytes released. */
+size_t arena_flatten(arena_t *arena, arena_reloc_fn fn, void *ctx) {
+#ifdef ARENA_MAPPED
+    if (arena->map_header) return 0;
+#endif
+    /* the inline block is always the first one */
+    arena_block_t **head = arena->inline_block ? &arena->inline_block->next : &arena->start;
+    size_t count = 0, total = 0, before = 0;
+    for (arena_block_t *b = *head; b != NULL; b = b->next) {
+        before += sizeof(arena_block_t) + b->size;
+        total  += b->used;
+        count  += b->used > 0;
+    }
+    if (*head == NULL || (*head)->next == NULL) return 0;
+
+    arena_block_t *flat = NULL;
+    arena_reloc_range_t *ranges = NULL;
+    if (total > 0) {
+        ranges = (arena_reloc_range_t*)malloc(sizeof(arena_reloc_range_t) * count);
+        flat   = arena_block_alloc(arena, total);
+        if (flat) ALLOC_PROBE3(block_acquire, arena, flat, flat->size);
+        if (!ranges || !flat) {
+            free(ranges);
+            if (flat) {
+                ALLOC_PROBE3(block_release, arena, flat, flat->size);
+                arena_block_free(arena, flat);
+            }
+            return 0;
+        }
+        ALLOC_UNPOISON(flat->bytes, total);
+
+        size_t n = 0;
+        for (arena_block_t *b = *head; b != NULL; b = b->next) {
+            if (b->used == 0) continue;
+            ALLOC_UNPOISON(b->bytes, b->used);
+            alloc_memcpy(&flat->bytes[flat->used], b->bytes, b->used);
+            ranges[n++] = (arena_reloc_range_t){
+                .old_start = b->bytes,
+                .new_start = &flat->bytes[flat->used],
+                .len       = b->used,
+            };
+            flat->used += b->used;
+        }
+#ifdef ARENA_PURGE
+        arena_block_mark(arena, flat);
+#endif
+        if (fn) {
+            arena_reloc_t reloc = { .ranges = ranges, .count = n };
+            fn(ctx, &reloc);
+        }
+        free(ranges);
+    }
+
+    arena_block_t *block = *head;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        ALLOC_PROBE3(block_release, arena, block, block->size);
+        arena_block_free(arena, block);
+        block = next;
+    }
+    *head      = flat;
+    arena->end = flat ? flat : arena->inline_block;
+
+    size_t after = flat ? sizeof(arena_block_t) + flat->size : 0;
+    return before - after;
+}
+
+void *arena_reloc_ptr(const arena_reloc_t *reloc, const void *old) {
+    const uint8_t *p = (const uint8_t*)old;
+    for (size_t i = 0; i < reloc->count; ++i) {
+        const arena_reloc_range_t *r = &reloc->ranges[i];
+        if (p >= r->old_start && p < r->old_start + r->len) {
+            return r->new_start + (p - r->old_start);
+        }
+    }
+    /* not arena memory, leave it */
+    return (void*)old;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/* describes the occupied bytes from 'from' up to the current end, in block
+ * order, as iovecs for writev/sendmsg. A marker from arena_snapshot on an
+ * empty arena (or a zeroed one) means the whole arena. Fills at most 'max'
+ * entries and returns how many are needed, like snprintf.
+ * The ranges are exactly the allocated bytes, in allocation order, only when
+ * everything since 'from' went through arena_alloc_bytes in append mode
+ * (arena_set_append). Otherwise arena_alloc may first-fit an allocation into
+ * a block before 'from.block', which is then missed or exported out of order,
+ * guarded samples are not in the blocks at all, and the ranges include the
+ * alignment padding and (with poisoning) the redzones of arena_alloc, which
+ * writev under ASan reports as use-after-poison. */
+size_t arena_to_iovec(arena_t *arena, arena_marker_t from, struct iovec *iov, size_t max) {
+    size_t n = 0;
+    arena_block_t *b      = from.block ? from.block : arena->start;
+    size_t         offset = from.block ? from.offset : 0;
+    for (; b != NULL; b = b->next, offset = 0) {
+        if (b->used <= offset) continue;
+        if (n < max) {
+            iov[n].iov_base = &b->bytes[offset];
+            iov[n].iov_len  = b->used - offset;
+        }
+        ++n;
+        if (b == arena->end) break;
+    }
+    return n;
+}
+#endif
+
 #endif /* ARENA_IMPL */
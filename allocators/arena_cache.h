@@ -0,0 +1,183 @@
+#ifndef ARENA_CACHE_H
+#define ARENA_CACHE_H
+
+#include <stddef.h>
+
+/* process-wide cache of arena blocks
+ * arena_block_free parks heap blocks here instead of returning them to libc,
+ * and arena_block_alloc takes a cached block of a fitting size before calling
+ * malloc, so arenas created and destroyed per request stop hitting the heap.
+ * Blocks are kept in power of two size classes, in ARENA_CACHE_SHARDS shards
+ * each behind its own spinlock; a thread always uses the same shard.
+ * Blocks larger than ARENA_CACHE_MAX_BLOCK are never cached and every shard
+ * holds at most its share of the limit set with arena_cache_set_limit. */
+
+#ifndef ARENA_CACHE_SHARDS
+#define ARENA_CACHE_SHARDS    (8u)
+#endif
+#ifndef ARENA_CACHE_MAX_BYTES
+#define ARENA_CACHE_MAX_BYTES (32u<<20)
+#endif
+#ifndef ARENA_CACHE_MAX_BLOCK
+#define ARENA_CACHE_MAX_BLOCK (4u<<20)
+#endif
+
+typedef struct arena_cache_stats {
+    size_t hits, misses;  /* arena_block_alloc served from the cache or not */
+    size_t puts, drops;   /* arena_block_free cached the block or freed it */
+    size_t blocks, bytes; /* currently cached */
+} arena_cache_stats_t;
+
+arena_cache_stats_t arena_cache_stats     (void);
+void                arena_cache_set_limit (size_t bytes);
+/* frees every cached block, returns their size in bytes */
+size_t              arena_cache_trim      (void);
+
+#endif /* ARENA_CACHE_H */
+
+
+#if defined(ARENA_CACHE_IMPL) && !defined(ARENA_CACHE_IMPL_DONE)
+#define ARENA_CACHE_IMPL_DONE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#define ARENA_CACHE_CLASSES (64u)
+
+typedef struct arena_cache_shard {
+    alignas(64) _Atomic int lock;
+    arena_block_t *classes[ARENA_CACHE_CLASSES]; /* class k holds sizes in [2^k, 2^(k+1)) */
+    size_t         blocks, bytes;
+    size_t         hits, misses, puts, drops;
+} arena_cache_shard_t;
+
+static arena_cache_shard_t arena_cache_shards[ARENA_CACHE_SHARDS];
+static _Atomic size_t      arena_cache_limit = ARENA_CACHE_MAX_BYTES;
+static _Atomic unsigned    arena_cache_next_shard;
+static _Thread_local unsigned arena_cache_shard_id; /* shard index + 1, 0 until first use */
+
+static arena_cache_shard_t *arena_cache_shard(void) {
+    if (arena_cache_shard_id == 0) {
+        arena_cache_shard_id = atomic_fetch_add(&arena_cache_next_shard, 1) % ARENA_CACHE_SHARDS + 1;
+    }
+    return &arena_cache_shards[arena_cache_shard_id - 1];
+}
+
+static void arena_cache_lock(arena_cache_shard_t *s) {
+    while (atomic_exchange_explicit(&s->lock, 1, memory_order_acquire)) {
+        while (atomic_load_explicit(&s->lock, memory_order_relaxed)) {}
+    }
+}
+
+static void arena_cache_unlock(arena_cache_shard_t *s) {
+    atomic_store_explicit(&s->lock, 0, memory_order_release);
+}
+
+static unsigned arena_cache_class(size_t size) {
+    return 63u - (unsigned)__builtin_clzll((unsigned long long)size);
+}
+
+/* a block of at least 'size' bytes from the calling thread's shard, or NULL */
+static arena_block_t *arena_cache_take(size_t size) {
+    if (size == 0 || size > ARENA_CACHE_MAX_BLOCK) return NULL;
+    arena_cache_shard_t *s = arena_cache_shard();
+    unsigned k = arena_cache_class(size);
+    arena_block_t *block = NULL;
+
+    arena_cache_lock(s);
+    /* first fit in the request's class, otherwise any block one class up,
+     * which wastes at most 3/4 of the block */
+    for (arena_block_t **link = &s->classes[k]; *link; link = &(*link)->next) {
+        if ((*link)->size >= size) {
+            block = *link;
+            *link = block->next;
+            break;
+        }
+    }
+    if (!block && k + 1 < ARENA_CACHE_CLASSES && s->classes[k + 1]) {
+        block = s->classes[k + 1];
+        s->classes[k + 1] = block->next;
+    }
+    if (block) {
+        s->blocks--;
+        s->bytes -= block->size;
+        s->hits++;
+    } else {
+        s->misses++;
+    }
+    arena_cache_unlock(s);
+    return block;
+}
+
+/* returns 1 if the cache kept the block */
+static int arena_cache_put(arena_block_t *block) {
+    if (block->size == 0 || block->size > ARENA_CACHE_MAX_BLOCK) return 0;
+    arena_cache_shard_t *s = arena_cache_shard();
+    size_t limit = atomic_load_explicit(&arena_cache_limit, memory_order_relaxed) / ARENA_CACHE_SHARDS;
+    unsigned k = arena_cache_class(block->size);
+    int kept = 0;
+
+    arena_cache_lock(s);
+    if (s->bytes + block->size <= limit) {
+        block->next    = s->classes[k];
+        s->classes[k]  = block;
+        s->blocks++;
+        s->bytes      += block->size;
+        s->puts++;
+        kept = 1;
+    } else {
+        s->drops++;
+    }
+    arena_cache_unlock(s);
+    return kept;
+}
+
+arena_cache_stats_t arena_cache_stats(void) {
+    arena_cache_stats_t st = {0};
+    for (size_t i = 0; i < ARENA_CACHE_SHARDS; ++i) {
+        arena_cache_shard_t *s = &arena_cache_shards[i];
+        arena_cache_lock(s);
+        st.hits   += s->hits;
+        st.misses += s->misses;
+        st.puts   += s->puts;
+        st.drops  += s->drops;
+        st.blocks += s->blocks;
+        st.bytes  += s->bytes;
+        arena_cache_unlock(s);
+    }
+    return st;
+}
+
+/* shards over the new limit shrink as their blocks are taken */
+void arena_cache_set_limit(size_t bytes) {
+    atomic_store(&arena_cache_limit, bytes);
+}
+
+size_t arena_cache_trim(void) {
+    size_t freed = 0;
+    for (size_t i = 0; i < ARENA_CACHE_SHARDS; ++i) {
+        arena_cache_shard_t *s = &arena_cache_shards[i];
+        arena_block_t *lists[ARENA_CACHE_CLASSES];
+
+        arena_cache_lock(s);
+        memcpy(lists, s->classes, sizeof(lists));
+        memset(s->classes, 0, sizeof(s->classes));
+        freed    += s->bytes;
+        s->blocks = 0;
+        s->bytes  = 0;
+        arena_cache_unlock(s);
+
+        for (size_t k = 0; k < ARENA_CACHE_CLASSES; ++k) {
+            for (arena_block_t *b = lists[k], *next; b != NULL; b = next) {
+                next = b->next;
+                ALLOC_UNPOISON(b->bytes, b->size);
+                free(b);
+            }
+        }
+    }
+    return freed;
+}
+
+#endif /* ARENA_CACHE_IMPL */
@@ -0,0 +1,103 @@
+#ifndef ALLOC_BUDGET_H
+#define ALLOC_BUDGET_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* memory budgets
+ * a budget counts the bytes charged to it against a soft and a hard limit
+ * (0 means no limit). Budgets chain through 'parent', so a tenant's arenas
+ * can each have their own budget and share a group budget above them; a
+ * charge has to fit every level of the chain or it is rejected as a whole.
+ * Crossing a soft limit calls the budget's callback once per crossing, on the
+ * thread that charged, after the charge went through. Crossing a hard limit
+ * fails the charge, which arenas turn into a NULL return.
+ *
+ *   alloc_budget_t tenant, request;
+ *   alloc_budget_init(&tenant,  "tenant-a",  0, 64u << 20, NULL);
+ *   alloc_budget_init(&request, "request",   1u << 20, 4u << 20, &tenant);
+ *   arena_set_budget(&arena, &request);
+ */
+
+typedef struct alloc_budget alloc_budget_t;
+typedef void (*alloc_budget_fn)(alloc_budget_t *budget, size_t charged, void *ctx);
+
+struct alloc_budget {
+    alloc_budget_t  *parent;
+    const char      *name;
+    size_t           soft, hard;
+    _Atomic size_t   charged;
+    _Atomic size_t   peak;
+    _Atomic size_t   soft_crossings, rejections;
+    alloc_budget_fn  on_soft;
+    void            *ctx;
+};
+
+void   alloc_budget_init        (alloc_budget_t *b, const char *name, size_t soft, size_t hard, alloc_budget_t *parent);
+void   alloc_budget_on_soft     (alloc_budget_t *b, alloc_budget_fn fn, void *ctx);
+/* returns 0 when charged, -1 when some level of the chain is over its hard
+ * limit; nothing is charged then and that level counts a rejection */
+int    alloc_budget_charge      (alloc_budget_t *b, size_t size);
+void   alloc_budget_release     (alloc_budget_t *b, size_t size);
+size_t alloc_budget_charged     (const alloc_budget_t *b);
+
+#endif /* ALLOC_BUDGET_H */
+
+
+#if defined(ALLOC_BUDGET_IMPL) && !defined(ALLOC_BUDGET_IMPL_DONE)
+#define ALLOC_BUDGET_IMPL_DONE
+
+void alloc_budget_init(alloc_budget_t *b, const char *name, size_t soft, size_t hard, alloc_budget_t *parent) {
+    b->parent = parent;
+    b->name   = name;
+    b->soft   = soft;
+    b->hard   = hard;
+    atomic_init(&b->charged, 0);
+    atomic_init(&b->peak, 0);
+    atomic_init(&b->soft_crossings, 0);
+    atomic_init(&b->rejections, 0);
+    b->on_soft = NULL;
+    b->ctx     = NULL;
+}
+
+void alloc_budget_on_soft(alloc_budget_t *b, alloc_budget_fn fn, void *ctx) {
+    b->on_soft = fn;
+    b->ctx     = ctx;
+}
+
+static void alloc_budget_uncharge(alloc_budget_t *from, alloc_budget_t *to, size_t size) {
+    for (alloc_budget_t *b = from; b != to; b = b->parent) atomic_fetch_sub(&b->charged, size);
+}
+
+int alloc_budget_charge(alloc_budget_t *b, size_t size) {
+    for (alloc_budget_t *level = b; level != NULL; level = level->parent) {
+        size_t old = atomic_fetch_add(&level->charged, size);
+        if (level->hard && (old + size > level->hard || old + size < old)) {
+            alloc_budget_uncharge(b, level->parent, size);
+            atomic_fetch_add(&level->rejections, 1);
+            return -1;
+        }
+    }
+
+    /* the whole chain accepted, now report peaks and soft crossings */
+    for (alloc_budget_t *level = b; level != NULL; level = level->parent) {
+        size_t now  = atomic_load(&level->charged);
+        size_t peak = atomic_load(&level->peak);
+        while (now > peak && !atomic_compare_exchange_weak(&level->peak, &peak, now)) {}
+        if (level->soft && now >= level->soft && now - size < level->soft) {
+            atomic_fetch_add(&level->soft_crossings, 1);
+            if (level->on_soft) level->on_soft(level, now, level->ctx);
+        }
+    }
+    return 0;
+}
+
+void alloc_budget_release(alloc_budget_t *b, size_t size) {
+    alloc_budget_uncharge(b, NULL, size);
+}
+
+size_t alloc_budget_charged(const alloc_budget_t *b) {
+    return atomic_load(&b->charged);
+}
+
+#endif /* ALLOC_BUDGET_IMPL */
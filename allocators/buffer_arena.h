@@ -0,0 +1,139 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#ifdef BUFFER_ARENA_IMPL
+#define VMEM_IMPL
+#endif
+#include "vmem.h"
+
+/* buffer arena for O_DIRECT and io_uring fixed buffers
+ * a fixed set of large regions is mapped up front and never moves, so the
+ * regions can be registered once with io_uring_register_buffers (see
+ * buffer_arena_iovecs). Buffers are bump allocated inside the regions with
+ * BUFFER_ARENA_ALIGN aligned addresses and lengths, and carry the index of
+ * their region, which is the buf_index of io_uring_prep_read/write_fixed. */
+
+#ifndef BUFFER_ARENA_ALIGN
+#define BUFFER_ARENA_ALIGN       (4096u)
+#endif
+#ifndef BUFFER_ARENA_MAX_REGIONS
+#define BUFFER_ARENA_MAX_REGIONS (16u)
+#endif
+
+typedef struct buffer_region {
+    vmem_t vm;
+    size_t used;
+} buffer_region_t;
+
+typedef struct buffer_arena {
+    buffer_region_t regions[BUFFER_ARENA_MAX_REGIONS];
+    uint32_t        count, current;
+} buffer_arena_t;
+
+typedef struct buffer {
+    void     *ptr;    /* NULL when every region is full, or len is 0 or too large */
+    size_t    len;
+    uint32_t  region;
+} buffer_t;
+
+/* flags are VMEM_POPULATE to prefault the regions. Returns 0 or -1 with errno */
+int      buffer_arena_init      (buffer_arena_t *ba, uint32_t regions, size_t region_size, int flags);
+void     buffer_arena_deinit    (buffer_arena_t *ba);
+buffer_t buffer_arena_alloc     (buffer_arena_t *ba, size_t len);
+void     buffer_arena_reset     (buffer_arena_t *ba);
+uint32_t buffer_arena_iovecs    (buffer_arena_t *ba, struct iovec *iov, uint32_t max);
+int      buffer_arena_region_of (buffer_arena_t *ba, const void *p);
+
+#endif /* BUFFER_ARENA_H */
+
+
+#ifdef BUFFER_ARENA_IMPL
+
+#include <errno.h>
+
+int buffer_arena_init(buffer_arena_t *ba, uint32_t regions, size_t region_size, int flags) {
+    *ba = (buffer_arena_t){0};
+    if (regions == 0 || regions > BUFFER_ARENA_MAX_REGIONS) {
+        errno = EINVAL;
+        return -1;
+    }
+    region_size = (region_size + BUFFER_ARENA_ALIGN - 1) & ~((size_t)BUFFER_ARENA_ALIGN - 1);
+    for (uint32_t i = 0; i < regions; ++i) {
+        /* reserve extra room so the first buffer can be aligned beyond a page */
+        size_t slack = BUFFER_ARENA_ALIGN > vmem_page_size() ? BUFFER_ARENA_ALIGN : 0;
+        vmem_t *vm = &ba->regions[i].vm;
+        if (vmem_reserve(vm, region_size + slack, -1, NULL, flags & VMEM_POPULATE) != 0 ||
+            vmem_commit(vm, region_size + slack) != 0) {
+            int err = errno;
+            if (vm->base) vmem_release(vm);
+            buffer_arena_deinit(ba);
+            errno = err;
+            return -1;
+        }
+        ba->count = i + 1;
+    }
+    return 0;
+}
+
+void buffer_arena_deinit(buffer_arena_t *ba) {
+    for (uint32_t i = 0; i < ba->count; ++i) {
+        vmem_release(&ba->regions[i].vm);
+    }
+    *ba = (buffer_arena_t){0};
+}
+
+static size_t buffer_region_fit(buffer_region_t *r, size_t len) {
+    uintptr_t base = (uintptr_t)r->vm.base;
+    uintptr_t at   = (base + r->used + BUFFER_ARENA_ALIGN - 1) & ~((uintptr_t)BUFFER_ARENA_ALIGN - 1);
+    size_t    off  = (size_t)(at - base);
+    if (off > r->vm.committed) return SIZE_MAX;
+    return len <= r->vm.committed - off ? off : SIZE_MAX;
+}
+
+buffer_t buffer_arena_alloc(buffer_arena_t *ba, size_t len) {
+    if (len == 0 || len > SIZE_MAX - (BUFFER_ARENA_ALIGN - 1)) return (buffer_t){0};
+    len = (len + BUFFER_ARENA_ALIGN - 1) & ~((size_t)BUFFER_ARENA_ALIGN - 1);
+    /* fill the current region, then move on to the first one with room */
+    for (uint32_t n = 0; n < ba->count; ++n) {
+        uint32_t i = (ba->current + n) % ba->count;
+        buffer_region_t *r = &ba->regions[i];
+        size_t off = buffer_region_fit(r, len);
+        if (off == SIZE_MAX) continue;
+        r->used     = off + len;
+        ba->current = i;
+        return (buffer_t){ .ptr = r->vm.base + off, .len = len, .region = i };
+    }
+    return (buffer_t){0};
+}
+
+void buffer_arena_reset(buffer_arena_t *ba) {
+    for (uint32_t i = 0; i < ba->count; ++i) {
+        ba->regions[i].used = 0;
+    }
+    ba->current = 0;
+}
+
+/* region i is iov[i], pass the result to io_uring_register_buffers */
+uint32_t buffer_arena_iovecs(buffer_arena_t *ba, struct iovec *iov, uint32_t max) {
+    uint32_t n = ba->count < max ? ba->count : max;
+    for (uint32_t i = 0; i < n; ++i) {
+        iov[i].iov_base = ba->regions[i].vm.base;
+        iov[i].iov_len  = ba->regions[i].vm.committed;
+    }
+    return n;
+}
+
+int buffer_arena_region_of(buffer_arena_t *ba, const void *p) {
+    const uint8_t *q = (const uint8_t*)p;
+    for (uint32_t i = 0; i < ba->count; ++i) {
+        const vmem_t *vm = &ba->regions[i].vm;
+        if (q >= vm->base && q < vm->base + vm->committed) return (int)i;
+    }
+    return -1;
+}
+
+#endif /* BUFFER_ARENA_IMPL */
@@ -0,0 +1,155 @@
+#ifndef ALLOC_CONF_H
+#define ALLOC_CONF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* runtime configuration
+ * read from the ALLOC_CONF environment variable on first use, or set with
+ * alloc_conf_set before that. Comma separated key:value pairs:
+ *
+ *   ALLOC_CONF="block_min:4k,block_max:4m,zero:false,stats:false"
+ *
+ *   block_min  first arena block size (default ARENA_BLOCKSIZE_MIN)
+ *   block_max  block size at which arenas stop growing (default ARENA_BLOCKSIZE_MAX)
+ *   zero       clear new heap blocks, calloc instead of malloc (default true)
+ *   stats      collect alloc.h allocator stats (default true)
+ *   purge      rewound bytes a block keeps resident before ARENA_PURGE
+ *              madvises them away (default ARENA_PURGE_THRESHOLD)
+ *
+ * Sizes take an optional k, m or g suffix. A string that does not parse is
+ * ignored as a whole and the compiled defaults are used. */
+
+typedef struct alloc_conf {
+    size_t block_min, block_max;
+    int    zero_blocks;
+    int    stats;
+    size_t purge_threshold;
+} alloc_conf_t;
+
+/* alloc_conf_set and alloc_conf_parse return 0 on success and -1 with errno
+ * set: EINVAL for a bad string, EBUSY when the configuration is already in use */
+const alloc_conf_t *alloc_conf       (void);
+int                 alloc_conf_set   (const char *conf);
+int                 alloc_conf_parse (alloc_conf_t *conf, const char *s);
+
+#endif /* ALLOC_CONF_H */
+
+
+#if defined(ALLOC_CONF_IMPL) && !defined(ALLOC_CONF_IMPL_DONE)
+#define ALLOC_CONF_IMPL_DONE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+static alloc_conf_t alloc_conf_current;
+static _Atomic int  alloc_conf_state; /* 0 unset, 1 being set, 2 ready */
+
+static alloc_conf_t alloc_conf_defaults(void) {
+    return (alloc_conf_t){
+        .block_min       = ARENA_BLOCKSIZE_MIN,
+        .block_max       = ARENA_BLOCKSIZE_MAX,
+        .zero_blocks     = 1,
+        .stats           = 1,
+        .purge_threshold = ARENA_PURGE_THRESHOLD,
+    };
+}
+
+static int alloc_conf_parse_size(const char *v, size_t len, size_t *out) {
+    if (*v < '0' || *v > '9') return -1;
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(v, &end, 10);
+    if (errno != 0) return -1;
+    unsigned shift = 0;
+    if (end < v + len) {
+        switch (*end++) {
+            case 'k': case 'K': shift = 10; break;
+            case 'm': case 'M': shift = 20; break;
+            case 'g': case 'G': shift = 30; break;
+            default: return -1;
+        }
+    }
+    if (end != v + len || n > (SIZE_MAX >> shift)) return -1;
+    *out = (size_t)n << shift;
+    return 0;
+}
+
+static int alloc_conf_parse_bool(const char *v, size_t len, int *out) {
+    if ((len == 4 && strncmp(v, "true", 4) == 0)  || (len == 1 && *v == '1')) *out = 1;
+    else if ((len == 5 && strncmp(v, "false", 5) == 0) || (len == 1 && *v == '0')) *out = 0;
+    else return -1;
+    return 0;
+}
+
+int alloc_conf_parse(alloc_conf_t *conf, const char *s) {
+    alloc_conf_t c = *conf;
+    while (*s) {
+        const char *key   = s;
+        const char *colon = strchr(key, ':');
+        if (!colon) goto invalid;
+        const char *v     = colon + 1;
+        size_t      klen  = (size_t)(colon - key);
+        size_t      vlen  = strcspn(v, ",");
+
+        int r;
+        if      (klen == 9 && strncmp(key, "block_min", 9) == 0) r = alloc_conf_parse_size(v, vlen, &c.block_min);
+        else if (klen == 9 && strncmp(key, "block_max", 9) == 0) r = alloc_conf_parse_size(v, vlen, &c.block_max);
+        else if (klen == 4 && strncmp(key, "zero",      4) == 0) r = alloc_conf_parse_bool(v, vlen, &c.zero_blocks);
+        else if (klen == 5 && strncmp(key, "stats",     5) == 0) r = alloc_conf_parse_bool(v, vlen, &c.stats);
+        else if (klen == 5 && strncmp(key, "purge",     5) == 0) r = alloc_conf_parse_size(v, vlen, &c.purge_threshold);
+        else r = -1;
+        if (r != 0) goto invalid;
+
+        s = v + vlen;
+        if (*s == ',') s++;
+    }
+    if (c.block_min == 0 || c.block_max < c.block_min) goto invalid;
+    *conf = c;
+    return 0;
+
+invalid:
+    errno = EINVAL;
+    return -1;
+}
+
+/* the first caller to get here decides the configuration, everyone else waits */
+static int alloc_conf_claim(void) {
+    int expected = 0;
+    return atomic_compare_exchange_strong(&alloc_conf_state, &expected, 1);
+}
+
+static void alloc_conf_publish(void) {
+    atomic_store_explicit(&alloc_conf_state, 2, memory_order_release);
+}
+
+const alloc_conf_t *alloc_conf(void) {
+    if (atomic_load_explicit(&alloc_conf_state, memory_order_acquire) == 2) return &alloc_conf_current;
+    if (alloc_conf_claim()) {
+        alloc_conf_current = alloc_conf_defaults();
+        const char *env = getenv("ALLOC_CONF");
+        if (env && alloc_conf_parse(&alloc_conf_current, env) != 0) {
+            fprintf(stderr, "alloc: invalid ALLOC_CONF \"%s\", using defaults\n", env);
+        }
+        alloc_conf_publish();
+    }
+    while (atomic_load_explicit(&alloc_conf_state, memory_order_acquire) != 2) {}
+    return &alloc_conf_current;
+}
+
+/* takes precedence over ALLOC_CONF, a bad string leaves the defaults in place */
+int alloc_conf_set(const char *conf) {
+    if (!alloc_conf_claim()) {
+        errno = EBUSY;
+        return -1;
+    }
+    alloc_conf_current = alloc_conf_defaults();
+    int r = alloc_conf_parse(&alloc_conf_current, conf);
+    alloc_conf_publish();
+    return r;
+}
+
+#endif /* ALLOC_CONF_IMPL */
@@ -0,0 +1,279 @@
+#ifndef GUARDED_H
+#define GUARDED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* sampled guarded allocations (GWP-ASan style)
+ * roughly one in GUARDED_SAMPLE_RATE allocations is served from a pool of
+ * page sized slots separated by PROT_NONE guard pages. The allocation is
+ * placed at the end of its slot, so running past it faults on the guard page.
+ * Released slots are protected too, so touching memory after the owner
+ * rewound or reset faults as well. The fault handler reports the access with
+ * the allocation (and release) stack and then lets the process crash. */
+
+#ifndef GUARDED_SAMPLE_RATE
+#define GUARDED_SAMPLE_RATE  (5000u)
+#endif
+#ifndef GUARDED_SLOTS
+#define GUARDED_SLOTS        (64u)
+#endif
+#ifndef GUARDED_STACK_DEPTH
+#define GUARDED_STACK_DEPTH  (16u)
+#endif
+
+/* guarded_release returns the number of slots released, owners keep count of
+ * their live slots and skip the call (and its lock) while they have none */
+void   guarded_set_sample_rate (uint32_t rate); /* 0 disables sampling */
+int    guarded_sample_slow     (void);
+void  *guarded_alloc           (void *owner, uint64_t seq, size_t size);
+size_t guarded_release         (void *owner, uint64_t from_seq);
+
+extern _Thread_local uint32_t guarded_countdown;
+
+/* fast path: a thread local decrement and a branch */
+static inline int guarded_should_sample(void) {
+    if (__builtin_expect(guarded_countdown > 1, 1)) {
+        --guarded_countdown;
+        return 0;
+    }
+    return guarded_sample_slow();
+}
+
+#endif /* GUARDED_H */
+
+
+#ifdef GUARDED_IMPL
+
+#include <time.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+typedef enum guarded_state {
+    GUARDED_SLOT_FREE,
+    GUARDED_SLOT_LIVE,
+    GUARDED_SLOT_RELEASED,
+} guarded_state_t;
+
+typedef struct guarded_slot {
+    guarded_state_t state;
+    void           *owner;
+    uint64_t        seq;
+    uint8_t        *ptr;
+    size_t          size;
+    int             alloc_depth, release_depth;
+    void           *alloc_stack[GUARDED_STACK_DEPTH];
+    void           *release_stack[GUARDED_STACK_DEPTH];
+} guarded_slot_t;
+
+static struct {
+    atomic_flag       lock;
+    int               ready;
+    uint8_t          *pool;
+    size_t            page, pool_size;
+    size_t            next;
+    _Atomic uint32_t  rate;
+    struct sigaction  prev_segv, prev_bus;
+    guarded_slot_t    slots[GUARDED_SLOTS];
+} guarded = {
+    .lock = ATOMIC_FLAG_INIT,
+    .rate = GUARDED_SAMPLE_RATE,
+};
+
+_Thread_local uint32_t guarded_countdown;
+static _Thread_local uint64_t guarded_rng;
+
+static void guarded_lock(void)   { while (atomic_flag_test_and_set_explicit(&guarded.lock, memory_order_acquire)) {} }
+static void guarded_unlock(void) { atomic_flag_clear_explicit(&guarded.lock, memory_order_release); }
+
+/* pool layout: [guard][slot 0][guard][slot 1][guard] ... [slot N-1][guard] */
+static uint8_t *guarded_slot_page(size_t i) {
+    return guarded.pool + guarded.page * (1 + 2 * i);
+}
+
+/* async-signal-safe reporting helpers */
+static void guarded_write(const char *s) {
+    ssize_t r = write(STDERR_FILENO, s, strlen(s));
+    (void)r;
+}
+
+static void guarded_write_hex(uintptr_t v) {
+    char buf[2 + 2 * sizeof(v) + 1];
+    buf[0] = '0'; buf[1] = 'x';
+    for (size_t i = 0; i < 2 * sizeof(v); ++i) {
+        buf[2 + i] = "0123456789abcdef"[(v >> (4 * (2 * sizeof(v) - 1 - i))) & 0xf];
+    }
+    buf[sizeof(buf) - 1] = '\0';
+    guarded_write(buf);
+}
+
+static void guarded_report(const char *kind, void *addr, guarded_slot_t *s) {
+    guarded_write("guarded: ");
+    guarded_write(kind);
+    guarded_write(" at ");
+    guarded_write_hex((uintptr_t)addr);
+    guarded_write(" on allocation ");
+    guarded_write_hex((uintptr_t)s->ptr);
+    guarded_write(" of size ");
+    guarded_write_hex(s->size);
+    guarded_write("\nallocated at:\n");
+    backtrace_symbols_fd(s->alloc_stack, s->alloc_depth, STDERR_FILENO);
+    if (s->state == GUARDED_SLOT_RELEASED) {
+        guarded_write("released at:\n");
+        backtrace_symbols_fd(s->release_stack, s->release_depth, STDERR_FILENO);
+    }
+}
+
+static void guarded_fault(int signo, siginfo_t *info, void *uctx) {
+    uint8_t *addr = (uint8_t*)info->si_addr;
+    struct sigaction *prev = signo == SIGBUS ? &guarded.prev_bus : &guarded.prev_segv;
+
+    if (addr >= guarded.pool && addr < guarded.pool + guarded.pool_size) {
+        size_t page = (size_t)(addr - guarded.pool) / guarded.page;
+        if (page % 2 == 1) {
+            guarded_slot_t *s = &guarded.slots[page / 2];
+            guarded_report(s->state == GUARDED_SLOT_RELEASED ? "use after rewind" : "invalid access", addr, s);
+        } else {
+            /* guard page: blame the live slot in front of it, else the one after */
+            size_t i = page / 2;
+            if (i > 0 && guarded.slots[i - 1].state != GUARDED_SLOT_FREE) {
+                guarded_report("buffer overflow", addr, &guarded.slots[i - 1]);
+            } else if (i < GUARDED_SLOTS && guarded.slots[i].state != GUARDED_SLOT_FREE) {
+                guarded_report("buffer underflow", addr, &guarded.slots[i]);
+            } else {
+                guarded_write("guarded: wild access in guard pool\n");
+            }
+        }
+        /* let the faulting instruction run again under the default action */
+        signal(signo, SIG_DFL);
+        return;
+    }
+
+    /* not ours, hand the fault to whoever was installed before */
+    if (prev->sa_flags & SA_SIGINFO) {
+        prev->sa_sigaction(signo, info, uctx);
+    } else if (prev->sa_handler != SIG_IGN && prev->sa_handler != SIG_DFL) {
+        prev->sa_handler(signo);
+    } else {
+        signal(signo, SIG_DFL);
+    }
+}
+
+static int guarded_init(void) {
+    guarded.page      = (size_t)sysconf(_SC_PAGESIZE);
+    guarded.pool_size = guarded.page * (1 + 2 * GUARDED_SLOTS);
+    void *pool = mmap(NULL, guarded.pool_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) return -1;
+    guarded.pool = (uint8_t*)pool;
+
+    /* backtrace() may allocate on its first call, do it outside the handler */
+    void *frame[1];
+    backtrace(frame, 1);
+
+    struct sigaction sa = {0};
+    sa.sa_sigaction = guarded_fault;
+    sa.sa_flags     = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &guarded.prev_segv);
+    sigaction(SIGBUS,  &sa, &guarded.prev_bus);
+    return 0;
+}
+
+void guarded_set_sample_rate(uint32_t rate) {
+    atomic_store(&guarded.rate, rate);
+}
+
+int guarded_sample_slow(void) {
+    int sample = guarded_countdown == 1;
+    uint32_t rate = atomic_load_explicit(&guarded.rate, memory_order_relaxed);
+    if (rate == 0) {
+        guarded_countdown = 1u << 16; /* look at the rate again later */
+        return 0;
+    }
+    if (guarded_rng == 0) {
+        guarded_rng = (uint64_t)(uintptr_t)&guarded_rng ^ (uint64_t)time(NULL) ^ 0x9e3779b97f4a7c15ull;
+    }
+    /* xorshift64, next sample uniformly in [1, 2*rate] averages one in rate */
+    guarded_rng ^= guarded_rng << 13;
+    guarded_rng ^= guarded_rng >> 7;
+    guarded_rng ^= guarded_rng << 17;
+    guarded_countdown = 1 + (uint32_t)(guarded_rng % (2ull * rate));
+    return sample;
+}
+
+void *guarded_alloc(void *owner, uint64_t seq, size_t size) {
+    void *stack[GUARDED_STACK_DEPTH];
+    int depth = backtrace(stack, GUARDED_STACK_DEPTH);
+
+    guarded_lock();
+    if (!guarded.ready) {
+        if (guarded_init() != 0) {
+            guarded_unlock();
+            return NULL;
+        }
+        guarded.ready = 1;
+    }
+    if (size == 0 || size > guarded.page) {
+        guarded_unlock();
+        return NULL;
+    }
+
+    /* round robin over the slots, keeping released ones around as long as
+     * possible so late accesses still get a useful report */
+    guarded_slot_t *slot = NULL;
+    for (size_t n = 0; n < GUARDED_SLOTS; ++n) {
+        size_t i = (guarded.next + n) % GUARDED_SLOTS;
+        if (guarded.slots[i].state != GUARDED_SLOT_LIVE) {
+            slot = &guarded.slots[i];
+            guarded.next = i + 1;
+            break;
+        }
+    }
+    if (!slot) {
+        guarded_unlock();
+        return NULL;
+    }
+
+    uint8_t *page = guarded_slot_page((size_t)(slot - guarded.slots));
+    if (mprotect(page, guarded.page, PROT_READ | PROT_WRITE) != 0) {
+        guarded_unlock();
+        return NULL;
+    }
+    slot->state       = GUARDED_SLOT_LIVE;
+    slot->owner       = owner;
+    slot->seq         = seq;
+    slot->size        = size;
+    slot->ptr         = page + guarded.page - size;
+    slot->alloc_depth = depth;
+    memcpy(slot->alloc_stack, stack, sizeof(stack[0]) * (size_t)depth);
+    guarded_unlock();
+
+    return slot->ptr;
+}
+
+size_t guarded_release(void *owner, uint64_t from_seq) {
+    void *stack[GUARDED_STACK_DEPTH];
+    int depth = -1;
+    size_t released = 0;
+
+    guarded_lock();
+    for (size_t i = 0; i < GUARDED_SLOTS; ++i) {
+        guarded_slot_t *s = &guarded.slots[i];
+        if (s->state != GUARDED_SLOT_LIVE || s->owner != owner || s->seq < from_seq) continue;
+        /* the stack is only worth its cost once a slot matches */
+        if (depth < 0) depth = backtrace(stack, GUARDED_STACK_DEPTH);
+        mprotect(guarded_slot_page(i), guarded.page, PROT_NONE);
+        s->state         = GUARDED_SLOT_RELEASED;
+        s->release_depth = depth;
+        memcpy(s->release_stack, stack, sizeof(stack[0]) * (size_t)depth);
+        released++;
+    }
+    guarded_unlock();
+    return released;
+}
+
+#endif /* GUARDED_IMPL */
@@ -0,0 +1,145 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stddef.h>
+
+/* copy and zero kernels for the allocators' bulk paths (zeroed allocation,
+ * realloc by copy, flatten). Small and medium ranges go to libc, which is
+ * already tuned for them. Ranges of ALLOC_NT_THRESHOLD bytes and more use
+ * non-temporal AVX-512/AVX2/SSE2 stores, picked at runtime from the CPU, so a
+ * large copy or clear does not evict the hot working set from the caches. */
+
+#ifndef ALLOC_NT_THRESHOLD
+#define ALLOC_NT_THRESHOLD (8u << 20)
+#endif
+/* below this the 64 byte aligned head and tail could overlap, so whatever the
+ * threshold smaller ranges always go to libc */
+#define ALLOC_NT_MIN       (128u)
+
+void alloc_memcpy  (void *dst, const void *src, size_t n);
+void alloc_memzero (void *dst, size_t n);
+
+#endif /* MEMOPS_H */
+
+
+#if defined(MEMOPS_IMPL) && !defined(MEMOPS_IMPL_DONE)
+#define MEMOPS_IMPL_DONE
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+
+/* dst is 64 byte aligned and n a multiple of 64 in all the kernels below */
+__attribute__((target("avx512f")))
+static void alloc_memcpy_nt_avx512(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i += 64) {
+        _mm512_stream_si512((__m512i*)(dst + i), _mm512_loadu_si512((const void*)(src + i)));
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void alloc_memzero_nt_avx512(uint8_t *dst, size_t n) {
+    __m512i z = _mm512_setzero_si512();
+    for (size_t i = 0; i < n; i += 64) _mm512_stream_si512((__m512i*)(dst + i), z);
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void alloc_memcpy_nt_avx2(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        _mm256_stream_si256((__m256i*)(dst + i), a);
+        _mm256_stream_si256((__m256i*)(dst + i + 32), b);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void alloc_memzero_nt_avx2(uint8_t *dst, size_t n) {
+    __m256i z = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += 64) {
+        _mm256_stream_si256((__m256i*)(dst + i), z);
+        _mm256_stream_si256((__m256i*)(dst + i + 32), z);
+    }
+    _mm_sfence();
+}
+
+static void alloc_memcpy_nt_sse2(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i += 64) {
+        for (size_t j = 0; j < 64; j += 16) {
+            _mm_stream_si128((__m128i*)(dst + i + j), _mm_loadu_si128((const __m128i*)(src + i + j)));
+        }
+    }
+    _mm_sfence();
+}
+
+static void alloc_memzero_nt_sse2(uint8_t *dst, size_t n) {
+    __m128i z = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += 16) _mm_stream_si128((__m128i*)(dst + i), z);
+    _mm_sfence();
+}
+
+static void (*alloc_memcpy_nt)(uint8_t*, const uint8_t*, size_t);
+static void (*alloc_memzero_nt)(uint8_t*, size_t);
+
+static void alloc_memops_resolve(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        alloc_memzero_nt = alloc_memzero_nt_avx512;
+        alloc_memcpy_nt  = alloc_memcpy_nt_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        alloc_memzero_nt = alloc_memzero_nt_avx2;
+        alloc_memcpy_nt  = alloc_memcpy_nt_avx2;
+    } else {
+        alloc_memzero_nt = alloc_memzero_nt_sse2;
+        alloc_memcpy_nt  = alloc_memcpy_nt_sse2;
+    }
+}
+
+/* head up to 64 byte alignment and the tail go through libc */
+void alloc_memcpy(void *dst, const void *src, size_t n) {
+    if (n < ALLOC_NT_THRESHOLD || n < ALLOC_NT_MIN) {
+        memcpy(dst, src, n);
+        return;
+    }
+    if (!alloc_memcpy_nt) alloc_memops_resolve();
+    uint8_t       *d = (uint8_t*)dst;
+    const uint8_t *s = (const uint8_t*)src;
+    size_t head = (size_t)(-(uintptr_t)d & 63);
+    memcpy(d, s, head);
+    size_t body = (n - head) & ~(size_t)63;
+    alloc_memcpy_nt(d + head, s + head, body);
+    memcpy(d + head + body, s + head + body, n - head - body);
+}
+
+void alloc_memzero(void *dst, size_t n) {
+    if (n < ALLOC_NT_THRESHOLD || n < ALLOC_NT_MIN) {
+        memset(dst, 0, n);
+        return;
+    }
+    if (!alloc_memzero_nt) alloc_memops_resolve();
+    uint8_t *d = (uint8_t*)dst;
+    size_t head = (size_t)(-(uintptr_t)d & 63);
+    memset(d, 0, head);
+    size_t body = (n - head) & ~(size_t)63;
+    alloc_memzero_nt(d + head, body);
+    memset(d + head + body, 0, n - head - body);
+}
+
+#else
+
+void alloc_memcpy(void *dst, const void *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+void alloc_memzero(void *dst, size_t n) {
+    memset(dst, 0, n);
+}
+
+#endif
+
+#endif /* MEMOPS_IMPL */
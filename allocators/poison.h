@@ -0,0 +1,43 @@
+#ifndef POISON_H
+#define POISON_H
+
+/* manual memory poisoning for AddressSanitizer and Valgrind memcheck
+ * ASan is picked up automatically (-fsanitize=address), Valgrind client
+ * requests are compiled in with ALLOC_VALGRIND (needs <valgrind/memcheck.h>).
+ * Allocators poison memory they own but did not hand out, so stale pointers
+ * into rewound or reset ranges are reported like heap use-after-free. */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ALLOC_ASAN
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) && !defined(ALLOC_ASAN)
+#define ALLOC_ASAN
+#endif
+
+#if defined(ALLOC_ASAN)
+#include <sanitizer/asan_interface.h>
+#define ALLOC_POISONING       (1)
+#define ALLOC_POISON(_p, _n)   ASAN_POISON_MEMORY_REGION((_p), (_n))
+#define ALLOC_UNPOISON(_p, _n) ASAN_UNPOISON_MEMORY_REGION((_p), (_n))
+#elif defined(ALLOC_VALGRIND)
+#include <valgrind/memcheck.h>
+#define ALLOC_POISONING       (1)
+#define ALLOC_POISON(_p, _n)   ((void)VALGRIND_MAKE_MEM_NOACCESS((_p), (_n)))
+#define ALLOC_UNPOISON(_p, _n) ((void)VALGRIND_MAKE_MEM_UNDEFINED((_p), (_n)))
+#else
+#define ALLOC_POISONING       (0)
+#define ALLOC_POISON(_p, _n)   ((void)(_p), (void)(_n))
+#define ALLOC_UNPOISON(_p, _n) ((void)(_p), (void)(_n))
+#endif
+
+/* poisoned gap left after every allocation, catches small overflows */
+#ifndef ALLOC_REDZONE
+#if ALLOC_POISONING
+#define ALLOC_REDZONE (16u)
+#else
+#define ALLOC_REDZONE (0u)
+#endif
+#endif
+
+#endif /* POISON_H */
@@ -0,0 +1,269 @@
+#ifndef ALLOC_PRESSURE_H
+#define ALLOC_PRESSURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* memory pressure response
+ * a monitor watches one pressure source and, when it fires, calls
+ * alloc_pressure_trigger, which
+ *   - bumps the process-wide pressure epoch: arenas built with ARENA_PRESSURE
+ *     see the change at their next arena_reset/arena_rewind and arena_trim
+ *     the blocks they keep past the rewound part
+ *   - empties the block cache (ARENA_CACHE) and, on glibc, malloc_trim()s
+ *   - runs the registered callbacks so the application can drop its own caches
+ *
+ * Sources:
+ *   PSI     a trigger on /proc/pressure/memory or a cgroup's memory.pressure,
+ *           fires when tasks stalled on memory for 'stall_us' within 'window_us'
+ *   cgroup  the cgroup v2 memory.events file, fires when the 'high', 'max' or
+ *           'oom' counters go up
+ *   synthetic  a pipe fired by alloc_pressure_inject, for tests
+ *
+ * The monitor does not start threads. Call alloc_pressure_poll from an
+ * existing loop or thread, or add alloc_pressure_fd to an epoll set and poll
+ * with a 0 timeout when it is ready. */
+
+#ifndef ALLOC_PRESSURE_CALLBACKS
+#define ALLOC_PRESSURE_CALLBACKS (16u)
+#endif
+
+typedef enum alloc_pressure_source {
+    ALLOC_PRESSURE_PSI,
+    ALLOC_PRESSURE_CGROUP,
+    ALLOC_PRESSURE_SYNTHETIC,
+} alloc_pressure_source_t;
+
+typedef struct alloc_pressure_monitor {
+    alloc_pressure_source_t source;
+    int                     fd;
+    int                     inject_fd;   /* write end of the synthetic pipe */
+    uint64_t                events;      /* high + max + oom seen on memory.events */
+    uint64_t                fired;       /* times this monitor triggered */
+} alloc_pressure_monitor_t;
+
+typedef void (*alloc_pressure_fn)(void *ctx);
+
+/* open functions return 0 on success and -1 with errno set.
+ * path NULL means /proc/pressure/memory for PSI */
+int      alloc_pressure_open_psi       (alloc_pressure_monitor_t *m, const char *path, uint32_t stall_us, uint32_t window_us);
+int      alloc_pressure_open_cgroup    (alloc_pressure_monitor_t *m, const char *cgroup_dir);
+int      alloc_pressure_open_synthetic (alloc_pressure_monitor_t *m);
+void     alloc_pressure_close          (alloc_pressure_monitor_t *m);
+int      alloc_pressure_fd             (const alloc_pressure_monitor_t *m);
+int      alloc_pressure_inject         (alloc_pressure_monitor_t *m);
+/* waits up to timeout_ms (-1 forever), returns 1 when pressure was handled,
+ * 0 on timeout and -1 with errno set on error */
+int      alloc_pressure_poll           (alloc_pressure_monitor_t *m, int timeout_ms);
+
+/* callbacks run on the thread that triggers, return 0 or -1 when full */
+int      alloc_pressure_register       (alloc_pressure_fn fn, void *ctx);
+void     alloc_pressure_unregister     (alloc_pressure_fn fn, void *ctx);
+void     alloc_pressure_trigger        (void);
+uint64_t alloc_pressure_epoch          (void);
+
+#endif /* ALLOC_PRESSURE_H */
+
+
+#if defined(ALLOC_PRESSURE_IMPL) && !defined(ALLOC_PRESSURE_IMPL_DONE)
+#define ALLOC_PRESSURE_IMPL_DONE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static _Atomic uint64_t alloc_pressure_epoch_value;
+static _Atomic int      alloc_pressure_lock;
+static struct {
+    alloc_pressure_fn fn;
+    void             *ctx;
+} alloc_pressure_callbacks[ALLOC_PRESSURE_CALLBACKS];
+
+static void alloc_pressure_acquire(void) {
+    while (atomic_exchange_explicit(&alloc_pressure_lock, 1, memory_order_acquire)) {}
+}
+
+static void alloc_pressure_release(void) {
+    atomic_store_explicit(&alloc_pressure_lock, 0, memory_order_release);
+}
+
+int alloc_pressure_register(alloc_pressure_fn fn, void *ctx) {
+    int r = -1;
+    alloc_pressure_acquire();
+    for (size_t i = 0; i < ALLOC_PRESSURE_CALLBACKS; ++i) {
+        if (alloc_pressure_callbacks[i].fn == NULL) {
+            alloc_pressure_callbacks[i].fn  = fn;
+            alloc_pressure_callbacks[i].ctx = ctx;
+            r = 0;
+            break;
+        }
+    }
+    alloc_pressure_release();
+    return r;
+}
+
+void alloc_pressure_unregister(alloc_pressure_fn fn, void *ctx) {
+    alloc_pressure_acquire();
+    for (size_t i = 0; i < ALLOC_PRESSURE_CALLBACKS; ++i) {
+        if (alloc_pressure_callbacks[i].fn == fn && alloc_pressure_callbacks[i].ctx == ctx) {
+            alloc_pressure_callbacks[i].fn  = NULL;
+            alloc_pressure_callbacks[i].ctx = NULL;
+        }
+    }
+    alloc_pressure_release();
+}
+
+uint64_t alloc_pressure_epoch(void) {
+    return atomic_load_explicit(&alloc_pressure_epoch_value, memory_order_relaxed);
+}
+
+void alloc_pressure_trigger(void) {
+    atomic_fetch_add(&alloc_pressure_epoch_value, 1);
+#ifdef ARENA_CACHE
+    arena_cache_trim();
+#endif
+
+    /* copy the list so callbacks may (un)register */
+    __typeof__(alloc_pressure_callbacks) callbacks;
+    alloc_pressure_acquire();
+    memcpy(callbacks, alloc_pressure_callbacks, sizeof(callbacks));
+    alloc_pressure_release();
+    for (size_t i = 0; i < ALLOC_PRESSURE_CALLBACKS; ++i) {
+        if (callbacks[i].fn) callbacks[i].fn(callbacks[i].ctx);
+    }
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
+
+/* sum of the counters that mean the cgroup is at or over its limits */
+static int alloc_pressure_read_events(int fd, uint64_t *events) {
+    char buf[512];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+
+    uint64_t sum = 0;
+    for (char *line = buf; line != NULL; ) {
+        char key[16];
+        unsigned long long value;
+        if (sscanf(line, "%15s %llu", key, &value) == 2 &&
+            (strcmp(key, "high") == 0 || strcmp(key, "max") == 0 || strcmp(key, "oom") == 0)) {
+            sum += value;
+        }
+        char *nl = strchr(line, '\n');
+        line = nl ? nl + 1 : NULL;
+    }
+    *events = sum;
+    return 0;
+}
+
+int alloc_pressure_open_psi(alloc_pressure_monitor_t *m, const char *path, uint32_t stall_us, uint32_t window_us) {
+    int fd = open(path ? path : "/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    char trigger[64];
+    int len = snprintf(trigger, sizeof(trigger), "some %u %u", stall_us, window_us);
+    if (write(fd, trigger, (size_t)len + 1) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    *m = (alloc_pressure_monitor_t){ .source = ALLOC_PRESSURE_PSI, .fd = fd, .inject_fd = -1 };
+    return 0;
+}
+
+int alloc_pressure_open_cgroup(alloc_pressure_monitor_t *m, const char *cgroup_dir) {
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/memory.events", cgroup_dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    *m = (alloc_pressure_monitor_t){ .source = ALLOC_PRESSURE_CGROUP, .fd = fd, .inject_fd = -1 };
+    if (alloc_pressure_read_events(fd, &m->events) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int alloc_pressure_open_synthetic(alloc_pressure_monitor_t *m) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    for (int i = 0; i < 2; ++i) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    *m = (alloc_pressure_monitor_t){ .source = ALLOC_PRESSURE_SYNTHETIC, .fd = fds[0], .inject_fd = fds[1] };
+    return 0;
+}
+
+void alloc_pressure_close(alloc_pressure_monitor_t *m) {
+    if (m->fd >= 0) close(m->fd);
+    if (m->inject_fd >= 0) close(m->inject_fd);
+    m->fd        = -1;
+    m->inject_fd = -1;
+}
+
+int alloc_pressure_fd(const alloc_pressure_monitor_t *m) {
+    return m->fd;
+}
+
+int alloc_pressure_inject(alloc_pressure_monitor_t *m) {
+    if (m->source != ALLOC_PRESSURE_SYNTHETIC) {
+        errno = EINVAL;
+        return -1;
+    }
+    char byte = 1;
+    return write(m->inject_fd, &byte, 1) == 1 || errno == EAGAIN ? 0 : -1;
+}
+
+int alloc_pressure_poll(alloc_pressure_monitor_t *m, int timeout_ms) {
+    struct pollfd p = {
+        .fd     = m->fd,
+        .events = m->source == ALLOC_PRESSURE_SYNTHETIC ? POLLIN : POLLPRI,
+    };
+    int n = poll(&p, 1, timeout_ms);
+    if (n <= 0) return n;
+
+    switch (m->source) {
+        case ALLOC_PRESSURE_PSI: {
+            /* POLLERR means the trigger is gone (e.g. the cgroup was removed) */
+            if (p.revents & POLLERR) {
+                errno = ENODEV;
+                return -1;
+            }
+        }
+        break;
+        case ALLOC_PRESSURE_CGROUP: {
+            /* kernfs reports every change of the file, not only the counters we want */
+            uint64_t events;
+            if (alloc_pressure_read_events(m->fd, &events) != 0) return -1;
+            int raised = events > m->events;
+            m->events = events;
+            if (!raised) return 0;
+        }
+        break;
+        case ALLOC_PRESSURE_SYNTHETIC: {
+            char buf[64];
+            while (read(m->fd, buf, sizeof(buf)) > 0) {}
+        }
+        break;
+    }
+    m->fired++;
+    alloc_pressure_trigger();
+    return 1;
+}
+
+#endif /* ALLOC_PRESSURE_IMPL */
@@ -0,0 +1,19 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+/* USDT static probes (provider 'alloc') for perf/bpftrace/systemtap.
+ * Define ALLOC_USDT to compile them in, this needs <sys/sdt.h> (systemtap-sdt-dev).
+ * An unattached probe costs a single nop, without ALLOC_USDT the macros expand
+ * to nothing and their arguments are not evaluated. */
+#ifdef ALLOC_USDT
+#include <sys/sdt.h>
+#define ALLOC_PROBE1(_name, _a)         DTRACE_PROBE1(alloc, _name, _a)
+#define ALLOC_PROBE2(_name, _a, _b)     DTRACE_PROBE2(alloc, _name, _a, _b)
+#define ALLOC_PROBE3(_name, _a, _b, _c) DTRACE_PROBE3(alloc, _name, _a, _b, _c)
+#else
+#define ALLOC_PROBE1(_name, _a)         ((void)0)
+#define ALLOC_PROBE2(_name, _a, _b)     ((void)0)
+#define ALLOC_PROBE3(_name, _a, _b, _c) ((void)0)
+#endif
+
+#endif /* PROBE_H */
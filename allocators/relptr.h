@@ -0,0 +1,76 @@
+#ifndef RELPTR_H
+#define RELPTR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* position independent pointers for data that is mapped at different addresses
+ * (files, shared memory). A self-relative pointer stores the distance from its
+ * own address to the target, so a structure can be moved or mapped anywhere as
+ * a whole. A base-relative pointer (offptr_t) stores the distance from a known
+ * base, such as arena_base() of a mapped arena. 0 encodes NULL in both, so a
+ * relptr_t can not point at itself and an offptr_t can not point at the base. */
+
+typedef int64_t  relptr_t;
+typedef uint64_t offptr_t;
+
+static inline relptr_t relptr_encode(const void *field, const void *p) {
+    return p ? (relptr_t)((intptr_t)p - (intptr_t)field) : 0;
+}
+
+static inline void *relptr_decode(const void *field, relptr_t off) {
+    return off ? (void*)((uint8_t*)field + off) : NULL;
+}
+
+static inline offptr_t offptr_encode(const void *base, const void *p) {
+    return p ? (offptr_t)((uintptr_t)p - (uintptr_t)base) : 0;
+}
+
+static inline void *offptr_decode(const void *base, offptr_t off) {
+    return off ? (void*)((uint8_t*)base + off) : NULL;
+}
+
+/* relptr_set(&node->next, other); next = relptr_get(struct node, &node->next); */
+#define relptr_set(_field, _p)      (*(_field) = relptr_encode((_field), (_p)))
+#define relptr_get(_T, _field)      ((_T*)relptr_decode((_field), *(_field)))
+#define offptr_set(_base, _field, _p) (*(_field) = offptr_encode((_base), (_p)))
+#define offptr_get(_T, _base, _off)   ((_T*)offptr_decode((_base), (_off)))
+
+#ifdef __cplusplus
+/* typed self-relative pointer, copies re-encode against their own address */
+template <typename T>
+class rel_ptr {
+public:
+    rel_ptr() : off_(0) {}
+    rel_ptr(T *p) : off_(relptr_encode(this, p)) {}
+    rel_ptr(const rel_ptr &o) : off_(relptr_encode(this, o.get())) {}
+
+    rel_ptr &operator=(const rel_ptr &o) { off_ = relptr_encode(this, o.get()); return *this; }
+    rel_ptr &operator=(T *p)             { off_ = relptr_encode(this, p);       return *this; }
+
+    T *get() const               { return static_cast<T*>(relptr_decode(this, off_)); }
+    T *operator->() const        { return get(); }
+    T &operator*() const         { return *get(); }
+    explicit operator bool() const { return off_ != 0; }
+
+private:
+    relptr_t off_;
+};
+
+/* typed base-relative pointer, the base is passed on every access */
+template <typename T>
+class off_ptr {
+public:
+    off_ptr() : off_(0) {}
+    off_ptr(const void *base, T *p) : off_(offptr_encode(base, p)) {}
+
+    T *get(const void *base) const { return static_cast<T*>(offptr_decode(base, off_)); }
+    offptr_t raw() const           { return off_; }
+    explicit operator bool() const { return off_ != 0; }
+
+private:
+    offptr_t off_;
+};
+#endif
+
+#endif /* RELPTR_H */
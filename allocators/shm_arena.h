@@ -0,0 +1,229 @@
+#ifndef SHM_ARENA_H
+#define SHM_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "relptr.h"
+
+/* shared memory arena
+ * a fixed size region backed by memfd_create (anonymous) or shm_open (named)
+ * that several processes map at the same time. The bump pointer lives in the
+ * region itself and is advanced atomically, so every process can allocate.
+ * Each process maps the region at its own address: pass offsets
+ * (shm_arena_off/shm_arena_ptr) between processes, never raw pointers.
+ * The fd of an anonymous region is handed to other processes over a unix
+ * socket with shm_arena_send_fd/shm_arena_recv_fd, or inherited across fork. */
+
+#define SHM_ARENA_MAGIC   (0x6e65726161686873ull) /* "shharena" */
+#define SHM_ARENA_VERSION (1u)
+
+typedef struct shm_arena_header {
+    uint64_t          magic, version;
+    uint64_t          size;  /* bytes of the whole region, header included */
+    _Atomic uint64_t  top;   /* offset of the first free byte */
+    _Atomic uint64_t  root;  /* offset of an object shared by convention */
+} shm_arena_header_t;
+
+typedef struct shm_arena {
+    shm_arena_header_t *header; /* start of the local mapping */
+    size_t              size;
+    int                 fd;
+} shm_arena_t;
+
+/* return 0 on success and -1 with errno set */
+int      shm_arena_create   (shm_arena_t *a, const char *name, size_t size);
+int      shm_arena_open     (shm_arena_t *a, const char *name);
+int      shm_arena_attach   (shm_arena_t *a, int fd);
+void     shm_arena_detach   (shm_arena_t *a);
+int      shm_arena_unlink   (const char *name);
+
+void    *shm_arena_alloc    (shm_arena_t *a, size_t size);
+void     shm_arena_reset    (shm_arena_t *a);
+offptr_t shm_arena_off      (shm_arena_t *a, const void *p);
+void    *shm_arena_ptr      (shm_arena_t *a, offptr_t off);
+void    *shm_arena_root     (shm_arena_t *a);
+void     shm_arena_set_root (shm_arena_t *a, void *root);
+
+int      shm_arena_send_fd  (int sock, int fd);
+int      shm_arena_recv_fd  (int sock);
+
+#endif /* SHM_ARENA_H */
+
+
+#ifdef SHM_ARENA_IMPL
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdalign.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define SHM_ARENA_ALIGN (alignof(max_align_t))
+
+static size_t shm_arena_header_size(void) {
+    return (sizeof(shm_arena_header_t) + SHM_ARENA_ALIGN - 1) & ~(SHM_ARENA_ALIGN - 1);
+}
+
+static int shm_arena_map(shm_arena_t *a, int fd, size_t size) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return -1;
+    *a = (shm_arena_t){
+        .header = (shm_arena_header_t*)base,
+        .size   = size,
+        .fd     = fd,
+    };
+    return 0;
+}
+
+/* name NULL creates an anonymous memfd region, otherwise a POSIX shm object */
+int shm_arena_create(shm_arena_t *a, const char *name, size_t size) {
+    int fd = name ? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)
+                  : (int)syscall(SYS_memfd_create, "shm_arena", 1u /* MFD_CLOEXEC */);
+    if (fd < 0) return -1;
+
+    if (size < shm_arena_header_size()) size = shm_arena_header_size();
+    if (ftruncate(fd, (off_t)size) != 0 || shm_arena_map(a, fd, size) != 0) {
+        int err = errno;
+        close(fd);
+        if (name) shm_unlink(name);
+        errno = err;
+        return -1;
+    }
+
+    a->header->magic   = SHM_ARENA_MAGIC;
+    a->header->version = SHM_ARENA_VERSION;
+    a->header->size    = size;
+    atomic_store(&a->header->root, 0);
+    atomic_store(&a->header->top, shm_arena_header_size());
+    return 0;
+}
+
+int shm_arena_open(shm_arena_t *a, const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return -1;
+    if (shm_arena_attach(a, fd) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int shm_arena_attach(shm_arena_t *a, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    if ((size_t)st.st_size < shm_arena_header_size()) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (shm_arena_map(a, fd, (size_t)st.st_size) != 0) return -1;
+    if (a->header->magic != SHM_ARENA_MAGIC || a->header->version != SHM_ARENA_VERSION) {
+        munmap(a->header, a->size);
+        a->header = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void shm_arena_detach(shm_arena_t *a) {
+    if (a->header) munmap(a->header, a->size);
+    if (a->fd >= 0) close(a->fd);
+    *a = (shm_arena_t){ .fd = -1 };
+}
+
+int shm_arena_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+/* lock-free: 'top' only moves when the allocation fits, so a request that
+ * does not fit fails alone and leaves the region usable for smaller ones */
+void *shm_arena_alloc(shm_arena_t *a, size_t size) {
+    if (size > a->header->size) return NULL;
+    size = (size + SHM_ARENA_ALIGN - 1) & ~(SHM_ARENA_ALIGN - 1);
+    uint64_t at = atomic_load_explicit(&a->header->top, memory_order_relaxed);
+    do {
+        if (size > a->header->size - at) return NULL;
+    } while (!atomic_compare_exchange_weak(&a->header->top, &at, at + size));
+    return (uint8_t*)a->header + at;
+}
+
+/* callers make sure no other process still uses the old contents */
+void shm_arena_reset(shm_arena_t *a) {
+    atomic_store(&a->header->top, shm_arena_header_size());
+}
+
+offptr_t shm_arena_off(shm_arena_t *a, const void *p) {
+    return offptr_encode(a->header, p);
+}
+
+void *shm_arena_ptr(shm_arena_t *a, offptr_t off) {
+    return offptr_decode(a->header, off);
+}
+
+void *shm_arena_root(shm_arena_t *a) {
+    return offptr_decode(a->header, atomic_load(&a->header->root));
+}
+
+void shm_arena_set_root(shm_arena_t *a, void *root) {
+    atomic_store(&a->header->root, offptr_encode(a->header, root));
+}
+
+int shm_arena_send_fd(int sock, int fd) {
+    char byte = 0;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        struct cmsghdr hdr;
+        char           buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg = {
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = ctrl.buf,
+        .msg_controllen = sizeof(ctrl.buf),
+    };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    return sendmsg(sock, &msg, 0) == 1 ? 0 : -1;
+}
+
+int shm_arena_recv_fd(int sock) {
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        struct cmsghdr hdr;
+        char           buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+
+    struct msghdr msg = {
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = ctrl.buf,
+        .msg_controllen = sizeof(ctrl.buf),
+    };
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) return -1;
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (!c || c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) {
+        errno = EBADMSG;
+        return -1;
+    }
+    int fd;
+    memcpy(&fd, CMSG_DATA(c), sizeof(int));
+    return fd;
+}
+
+#endif /* SHM_ARENA_IMPL */
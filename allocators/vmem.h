@@ -0,0 +1,128 @@
+#ifndef VMEM_H
+#define VMEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* virtual memory range: a contiguous reservation that is committed from the
+ * front, either anonymous or backed by a file mapped MAP_SHARED. The base
+ * address never moves while the range is alive. */
+
+enum {
+    VMEM_FIXED    = 1 << 0, /* reserve exactly at the hint or fail */
+    VMEM_POPULATE = 1 << 1, /* prefault committed pages (MAP_POPULATE) */
+    VMEM_WILLNEED = 1 << 2, /* start readahead of committed pages (MADV_WILLNEED) */
+};
+
+typedef struct vmem {
+    uint8_t *base;
+    size_t   reserved, committed;
+    int      fd, flags;
+} vmem_t;
+
+size_t vmem_page_size (void);
+int    vmem_reserve   (vmem_t *vm, size_t size, int fd, void *hint, int flags);
+int    vmem_commit    (vmem_t *vm, size_t size);
+int    vmem_sync      (vmem_t *vm);
+void   vmem_release   (vmem_t *vm);
+
+#endif /* VMEM_H */
+
+
+/* several modules build on vmem, emit the implementation only once */
+#if defined(VMEM_IMPL) && !defined(VMEM_IMPL_DONE)
+#define VMEM_IMPL_DONE
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+size_t vmem_page_size(void) {
+    static size_t page = 0;
+    if (page == 0) page = (size_t)sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+/* maps the already existing part of the file (fd >= 0) right away */
+int vmem_reserve(vmem_t *vm, size_t size, int fd, void *hint, int flags) {
+    size_t page = vmem_page_size();
+    size = (size + page - 1) & ~(page - 1);
+
+    int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    if (flags & VMEM_FIXED) map_flags |= MAP_FIXED_NOREPLACE;
+    void *base = mmap(hint, size, PROT_NONE, map_flags, -1, 0);
+    if (base == MAP_FAILED) return -1;
+    if ((flags & VMEM_FIXED) && base != hint) {
+        /* old kernels ignore MAP_FIXED_NOREPLACE and treat it as a hint */
+        munmap(base, size);
+        errno = EEXIST;
+        return -1;
+    }
+
+    *vm = (vmem_t){
+        .base     = (uint8_t*)base,
+        .reserved = size,
+        .fd       = fd,
+        .flags    = flags,
+    };
+
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || vmem_commit(vm, (size_t)st.st_size) != 0) {
+            int err = errno;
+            vmem_release(vm);
+            errno = err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int vmem_commit(vmem_t *vm, size_t size) {
+    size = (size + vmem_page_size() - 1) & ~(vmem_page_size() - 1);
+    if (size <= vm->committed) return 0;
+    if (size > vm->reserved) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t   delta = size - vm->committed;
+    uint8_t *at    = vm->base + vm->committed;
+    void    *p;
+    if (vm->fd >= 0) {
+        struct stat st;
+        if (fstat(vm->fd, &st) != 0) return -1;
+        if ((size_t)st.st_size < size && ftruncate(vm->fd, (off_t)size) != 0) return -1;
+        int map_flags = MAP_SHARED | MAP_FIXED;
+        if (vm->flags & VMEM_POPULATE) map_flags |= MAP_POPULATE;
+        p = mmap(at, delta, PROT_READ | PROT_WRITE, map_flags, vm->fd, (off_t)vm->committed);
+    } else {
+        int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+        if (vm->flags & VMEM_POPULATE) map_flags |= MAP_POPULATE;
+        p = mmap(at, delta, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+    }
+    if (p == MAP_FAILED) return -1;
+    if (vm->flags & VMEM_WILLNEED) madvise(at, delta, MADV_WILLNEED);
+
+    vm->committed = size;
+    return 0;
+}
+
+int vmem_sync(vmem_t *vm) {
+    if (vm->fd < 0 || vm->committed == 0) return 0;
+    return msync(vm->base, vm->committed, MS_SYNC);
+}
+
+void vmem_release(vmem_t *vm) {
+    if (vm->base) munmap(vm->base, vm->reserved);
+    vm->base      = NULL;
+    vm->reserved  = 0;
+    vm->committed = 0;
+}
+
+#endif /* VMEM_IMPL */
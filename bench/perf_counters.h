@@ -0,0 +1,133 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/* hardware counters for the benchmarks through perf_event_open (Linux only)
+ * cycles, instructions, L1d read misses, LLC misses, dTLB read misses and
+ * page faults are opened as one group, so they count over the same interval.
+ * Counters the CPU, kernel or perf_event_paranoid refuse stay closed and read
+ * as unavailable, without any counter the benchmarks only report timings.
+ * User space only, so perf_event_paranoid <= 2 is enough.
+ *
+ *   perf_counters_t pc;
+ *   perf_counters_open(&pc);
+ *   perf_counters_start(&pc);
+ *   ... measured code ...
+ *   perf_counters_stop(&pc);  // pc.value[i] valid where pc.fd[i] >= 0
+ *   perf_counters_close(&pc);
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTERS,
+};
+
+static const char *const perf_counter_names[PERF_COUNTERS] = {
+    "cycles", "instr", "L1d-miss", "LLC-miss", "dTLB-miss", "faults",
+};
+
+typedef struct perf_counters {
+    int      fd[PERF_COUNTERS]; /* -1 when unavailable */
+    int      leader;            /* fd of the group leader, -1 without counters */
+    uint64_t value[PERF_COUNTERS];
+} perf_counters_t;
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int perf_counter_open(uint32_t type, uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = group < 0; /* members follow the leader */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+#define PERF_CACHE_MISS(_cache) \
+    ((_cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/* returns the number of counters opened */
+static int perf_counters_open(perf_counters_t *pc) {
+    static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTERS] = {
+        [PERF_CYCLES]       = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        [PERF_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        [PERF_L1D_MISSES]   = { PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+        [PERF_LLC_MISSES]   = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        [PERF_DTLB_MISSES]  = { PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+        [PERF_PAGE_FAULTS]  = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    };
+    int opened = 0;
+    pc->leader = -1;
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        pc->value[i] = 0;
+        pc->fd[i]    = perf_counter_open(events[i].type, events[i].config, pc->leader);
+        if (pc->fd[i] < 0) continue;
+        if (pc->leader < 0) pc->leader = pc->fd[i];
+        opened++;
+    }
+    return opened;
+}
+
+static void perf_counters_start(perf_counters_t *pc) {
+    if (pc->leader < 0) return;
+    ioctl(pc->leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+    ioctl(pc->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/* a group the PMU could not schedule reads as unavailable, a partly
+ * scheduled one is scaled up to the whole interval */
+static void perf_counters_stop(perf_counters_t *pc) {
+    if (pc->leader < 0) return;
+    ioctl(pc->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        uint64_t v[3]; /* value, time enabled, time running */
+        if (pc->fd[i] < 0 || read(pc->fd[i], v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0) {
+            pc->value[i] = UINT64_MAX;
+            continue;
+        }
+        pc->value[i] = v[2] < v[1] ? (uint64_t)((double)v[0] * (double)v[1] / (double)v[2]) : v[0];
+    }
+}
+
+static void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+    pc->leader = -1;
+}
+
+#else
+
+static int perf_counters_open(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_COUNTERS; ++i) pc->fd[i] = -1;
+    pc->leader = -1;
+    return 0;
+}
+static void perf_counters_start(perf_counters_t *pc) { (void)pc; }
+static void perf_counters_stop (perf_counters_t *pc) { (void)pc; }
+static void perf_counters_close(perf_counters_t *pc) { (void)pc; }
+
+#endif
+
+/* whether counter i has a value from the last perf_counters_stop */
+static inline int perf_counter_valid(const perf_counters_t *pc, int i) {
+    return pc->fd[i] >= 0 && pc->value[i] != UINT64_MAX;
+}
+
+#endif /* PERF_COUNTERS_H */
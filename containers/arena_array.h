@@ -0,0 +1,80 @@
+#ifndef ARENA_ARRAY_H
+#define ARENA_ARRAY_H
+
+#include <string.h>
+
+#include "../allocators/arena.h"
+
+/* arena backed dynamic array
+ * ARENA_ARRAY_DEFINE(int_array, int) generates int_array_t and the
+ * int_array_* functions below. Growing extends the buffer in place while it
+ * is the last allocation of its arena block, otherwise it moves to a buffer
+ * twice the size and the old one stays in the arena until reset/rewind.
+ * finalize gives the unused capacity back when the buffer is still on top.
+ *
+ *   int_array_t a;
+ *   int_array_init(&a, &arena);
+ *   int_array_push(&a, 42);
+ *   int *items = int_array_finalize(&a);
+ */
+
+#ifndef ARENA_ARRAY_MIN_CAP
+#define ARENA_ARRAY_MIN_CAP (8u)
+#endif
+
+#define ARENA_ARRAY_DEFINE(_name, _T)                                               \
+typedef struct _name {                                                              \
+    _T      *items;                                                                 \
+    size_t   len, cap;                                                              \
+    arena_t *arena;                                                                 \
+} _name##_t;                                                                        \
+                                                                                    \
+static inline void _name##_init(_name##_t *a, arena_t *arena) {                     \
+    a->items = NULL;                                                                \
+    a->len   = 0;                                                                   \
+    a->cap   = 0;                                                                   \
+    a->arena = arena;                                                               \
+}                                                                                   \
+                                                                                    \
+/* returns 0 on success, -1 if the arena is out of memory */                        \
+static inline int _name##_reserve(_name##_t *a, size_t cap) {                       \
+    if (cap <= a->cap) return 0;                                                    \
+    /* exact growth while in place is possible, geometric when copying */           \
+    if (arena_resize(a->arena, a->items, sizeof(_T) * a->cap, sizeof(_T) * cap)) {  \
+        a->cap = cap;                                                               \
+        return 0;                                                                   \
+    }                                                                               \
+    size_t new_cap = max(max(cap, a->cap * 2), (size_t)ARENA_ARRAY_MIN_CAP);        \
+    _T *items = (_T*)arena_realloc(a->arena, a->items,                              \
+                                   sizeof(_T) * a->cap, sizeof(_T) * new_cap);      \
+    if (!items) return -1;                                                          \
+    a->items = items;                                                               \
+    a->cap   = new_cap;                                                             \
+    return 0;                                                                       \
+}                                                                                   \
+                                                                                    \
+static inline _T *_name##_push(_name##_t *a, _T v) {                                \
+    if (a->len == a->cap && _name##_reserve(a, a->len + 1) != 0) return NULL;       \
+    a->items[a->len] = v;                                                           \
+    return &a->items[a->len++];                                                     \
+}                                                                                   \
+                                                                                    \
+static inline _T *_name##_push_n(_name##_t *a, const _T *v, size_t n) {             \
+    if (_name##_reserve(a, a->len + n) != 0) return NULL;                           \
+    memcpy(&a->items[a->len], v, sizeof(_T) * n);                                   \
+    a->len += n;                                                                    \
+    return &a->items[a->len - n];                                                   \
+}                                                                                   \
+                                                                                    \
+static inline _T _name##_pop(_name##_t *a) {                                        \
+    return a->items[--a->len];                                                      \
+}                                                                                   \
+                                                                                    \
+/* shrink to fit, the array can keep growing afterwards */                          \
+static inline _T *_name##_finalize(_name##_t *a) {                                  \
+    if (arena_resize(a->arena, a->items, sizeof(_T) * a->cap, sizeof(_T) * a->len)) \
+        a->cap = a->len;                                                            \
+    return a->items;                                                                \
+}
+
+#endif /* ARENA_ARRAY_H */
@@ -0,0 +1,244 @@
+#ifndef ARENA_MAP_H
+#define ARENA_MAP_H
+
+#include <string.h>
+
+#include "../allocators/arena.h"
+
+/* arena backed open addressing hash map (Swiss table layout)
+ * every slot has a control byte: EMPTY, DELETED or the low 7 bits of the key
+ * hash. Lookups compare a whole group of control bytes at once (32 with AVX2,
+ * 16 with SSE2, 8 bytes with the portable fallback) and only touch slots whose
+ * byte matches. Control bytes and slots are a single arena allocation, there
+ * is no per entry memory, and the map is dropped with its arena.
+ * When the table is the last allocation of its block, growing rehashes into
+ * fresh space right behind it and slides the result back, so the old table's
+ * space is reused instead of being stranded.
+ *
+ *   static uint64_t str_hash(const char *s) { return arena_map_hash_bytes(s, strlen(s)); }
+ *   static int      str_eq  (const char *a, const char *b) { return strcmp(a, b) == 0; }
+ *   ARENA_MAP_DEFINE(str_map, const char*, int, str_hash, str_eq)
+ *
+ *   str_map_t m;
+ *   str_map_init(&m, &arena);
+ *   str_map_put(&m, "one", 1);
+ *   int *v = str_map_get(&m, "one");
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ARENA_MAP_GROUP (32u)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define ARENA_MAP_GROUP (16u)
+#else
+#define ARENA_MAP_GROUP (8u)
+#endif
+
+#define ARENA_MAP_EMPTY   ((uint8_t)0x80)
+#define ARENA_MAP_DELETED ((uint8_t)0xfe)
+
+/* bit i set when control byte i equals 'b' */
+static inline uint32_t arena_map_group_match(const uint8_t *ctrl, uint8_t b) {
+#if defined(__AVX2__)
+    __m256i g = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)b)));
+#elif defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < ARENA_MAP_GROUP; ++i) mask |= (uint32_t)(ctrl[i] == b) << i;
+    return mask;
+#endif
+}
+
+/* bit i set when control byte i is EMPTY or DELETED (high bit set) */
+static inline uint32_t arena_map_group_free(const uint8_t *ctrl) {
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ctrl));
+#elif defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < ARENA_MAP_GROUP; ++i) mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+/* hash helpers */
+static inline uint64_t arena_map_hash_u64(uint64_t x) {
+    /* splitmix64 finalizer */
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t arena_map_hash_bytes(const void *p, size_t n) {
+    /* FNV-1a, mixed so the low 7 bits are usable */
+    const uint8_t *b = (const uint8_t*)p;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; ++i) h = (h ^ b[i]) * 0x100000001b3ull;
+    return arena_map_hash_u64(h);
+}
+
+#define ARENA_MAP_DEFINE(_name, _K, _V, _hash, _eq)                                     \
+typedef struct _name##_slot {                                                           \
+    _K key;                                                                             \
+    _V value;                                                                           \
+} _name##_slot_t;                                                                       \
+                                                                                        \
+typedef struct _name {                                                                  \
+    uint8_t        *ctrl;                                                               \
+    _name##_slot_t *slots;                                                              \
+    size_t          len, cap, tombstones;                                               \
+    arena_t        *arena;                                                              \
+} _name##_t;                                                                            \
+                                                                                        \
+static inline size_t _name##_ctrl_bytes(size_t cap) {                                   \
+    return round_up_to_multiple(cap, MAX_ALIGN);                                        \
+}                                                                                       \
+                                                                                        \
+static inline size_t _name##_bytes(size_t cap) {                                        \
+    return cap ? _name##_ctrl_bytes(cap) + sizeof(_name##_slot_t) * cap : 0;            \
+}                                                                                       \
+                                                                                        \
+static inline void _name##_bind(_name##_t *m, uint8_t *mem) {                           \
+    m->ctrl  = mem;                                                                     \
+    m->slots = mem ? (_name##_slot_t*)(mem + _name##_ctrl_bytes(m->cap)) : NULL;        \
+}                                                                                       \
+                                                                                        \
+/* the only places that call _hash and _eq, the prefixed parameters can not             \
+ * shadow user functions named like the locals below */                                 \
+static inline uint64_t _name##_hash_key(_K _am_key) {                                   \
+    return (uint64_t)_hash(_am_key);                                                    \
+}                                                                                       \
+                                                                                        \
+static inline int _name##_key_eq(_K _am_a, _K _am_b) {                                  \
+    return _eq(_am_a, _am_b);                                                           \
+}                                                                                       \
+                                                                                        \
+static inline void _name##_init(_name##_t *m, arena_t *arena) {                         \
+    m->ctrl       = NULL;                                                               \
+    m->slots      = NULL;                                                               \
+    m->len        = 0;                                                                  \
+    m->cap        = 0;                                                                  \
+    m->tombstones = 0;                                                                  \
+    m->arena      = arena;                                                              \
+}                                                                                       \
+                                                                                        \
+/* first free slot on the probe sequence, the key must not be present */                \
+static inline size_t _name##_find_free(const uint8_t *ctrl, size_t cap, uint64_t h) {   \
+    size_t mask = cap / ARENA_MAP_GROUP - 1;                                            \
+    size_t g    = (size_t)(h >> 7) & mask;                                              \
+    for (size_t i = 1; ; ++i) {                                                         \
+        uint32_t free_bits = arena_map_group_free(&ctrl[g * ARENA_MAP_GROUP]);          \
+        if (free_bits) return g * ARENA_MAP_GROUP + (size_t)__builtin_ctz(free_bits);   \
+        g = (g + i) & mask;                                                             \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static inline size_t _name##_find(const _name##_t *m, _K key, uint64_t h) {             \
+    if (m->cap == 0) return SIZE_MAX;                                                   \
+    size_t  mask = m->cap / ARENA_MAP_GROUP - 1;                                        \
+    size_t  g    = (size_t)(h >> 7) & mask;                                             \
+    uint8_t h2   = (uint8_t)(h & 0x7f);                                                 \
+    /* triangular probing over groups visits every group once */                        \
+    for (size_t i = 1; i <= mask + 1; ++i) {                                            \
+        const uint8_t *ctrl = &m->ctrl[g * ARENA_MAP_GROUP];                            \
+        for (uint32_t hit = arena_map_group_match(ctrl, h2); hit; hit &= hit - 1) {     \
+            size_t s = g * ARENA_MAP_GROUP + (size_t)__builtin_ctz(hit);                \
+            if (_name##_key_eq(m->slots[s].key, key)) return s;                         \
+        }                                                                               \
+        if (arena_map_group_match(ctrl, ARENA_MAP_EMPTY)) return SIZE_MAX;              \
+        g = (g + i) & mask;                                                             \
+    }                                                                                   \
+    return SIZE_MAX;                                                                    \
+}                                                                                       \
+                                                                                        \
+/* returns 0 on success, -1 if the arena is out of memory */                            \
+static inline int _name##_rehash(_name##_t *m, size_t new_cap) {                        \
+    size_t   old_bytes = _name##_bytes(m->cap);                                         \
+    size_t   new_bytes = _name##_bytes(new_cap);                                        \
+    uint8_t *old_mem   = m->ctrl;                                                       \
+    int      on_top    = old_mem && arena_resize(m->arena, old_mem, old_bytes, old_bytes); \
+                                                                                        \
+    uint8_t *mem = (uint8_t*)arena_alloc(m->arena, new_bytes);                          \
+    if (!mem) return -1;                                                                \
+    memset(mem, ARENA_MAP_EMPTY, new_cap);                                              \
+    _name##_slot_t *slots = (_name##_slot_t*)(mem + _name##_ctrl_bytes(new_cap));       \
+    for (size_t i = 0; i < m->cap; ++i) {                                               \
+        if (m->ctrl[i] & 0x80) continue;                                                \
+        uint64_t h = _name##_hash_key(m->slots[i].key);                                 \
+        size_t   s = _name##_find_free(mem, new_cap, h);                                \
+        mem[s]   = (uint8_t)(h & 0x7f);                                                 \
+        slots[s] = m->slots[i];                                                         \
+    }                                                                                   \
+                                                                                        \
+    /* the new table landed right behind the old one: slide it down */                 \
+    size_t span = (size_t)(mem - old_mem) + new_bytes;                                  \
+    if (on_top && mem > old_mem && arena_resize(m->arena, old_mem, span, span)) {       \
+        ALLOC_UNPOISON(old_mem, span);                                                  \
+        memmove(old_mem, mem, new_bytes);                                               \
+        arena_resize(m->arena, old_mem, span, new_bytes);                               \
+        mem = old_mem;                                                                  \
+    }                                                                                   \
+    m->cap        = new_cap;                                                            \
+    m->tombstones = 0;                                                                  \
+    _name##_bind(m, mem);                                                               \
+    return 0;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* room for n entries under the 7/8 load factor */                                      \
+static inline int _name##_reserve(_name##_t *m, size_t n) {                             \
+    size_t cap = ARENA_MAP_GROUP;                                                       \
+    while (cap - cap / 8 < n) cap *= 2;                                                 \
+    return cap > m->cap ? _name##_rehash(m, cap) : 0;                                   \
+}                                                                                       \
+                                                                                        \
+static inline _V *_name##_get(const _name##_t *m, _K key) {                             \
+    size_t s = _name##_find(m, key, _name##_hash_key(key));                             \
+    return s == SIZE_MAX ? NULL : &m->slots[s].value;                                   \
+}                                                                                       \
+                                                                                        \
+/* inserts or overwrites, returns the stored value or NULL when out of memory */        \
+static inline _V *_name##_put(_name##_t *m, _K key, _V value) {                         \
+    uint64_t h = _name##_hash_key(key);                                                 \
+    size_t   s = _name##_find(m, key, h);                                               \
+    if (s != SIZE_MAX) {                                                                \
+        m->slots[s].value = value;                                                      \
+        return &m->slots[s].value;                                                      \
+    }                                                                                   \
+    if (m->len + m->tombstones + 1 > m->cap - m->cap / 8) {                             \
+        /* mostly tombstones: rehash at the same size */                                \
+        size_t cap = m->cap ? m->cap : ARENA_MAP_GROUP;                                 \
+        if (m->len + 1 > cap / 2) cap *= 2;                                             \
+        if (_name##_rehash(m, cap) != 0) return NULL;                                   \
+    }                                                                                   \
+    s = _name##_find_free(m->ctrl, m->cap, h);                                          \
+    if (m->ctrl[s] == ARENA_MAP_DELETED) m->tombstones--;                               \
+    m->ctrl[s]  = (uint8_t)(h & 0x7f);                                                  \
+    m->slots[s] = (_name##_slot_t){ .key = key, .value = value };                       \
+    m->len++;                                                                           \
+    return &m->slots[s].value;                                                          \
+}                                                                                       \
+                                                                                        \
+static inline int _name##_remove(_name##_t *m, _K key) {                                \
+    size_t s = _name##_find(m, key, _name##_hash_key(key));                             \
+    if (s == SIZE_MAX) return 0;                                                        \
+    m->ctrl[s] = ARENA_MAP_DELETED;                                                     \
+    m->len--;                                                                           \
+    m->tombstones++;                                                                    \
+    return 1;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* size_t it = 0; while ((slot = str_map_next(&m, &it))) { ... } */                     \
+static inline _name##_slot_t *_name##_next(const _name##_t *m, size_t *it) {            \
+    for (; *it < m->cap; ++*it) {                                                       \
+        if (!(m->ctrl[*it] & 0x80)) return &m->slots[(*it)++];                          \
+    }                                                                                   \
+    return NULL;                                                                        \
+}
+
+#endif /* ARENA_MAP_H */
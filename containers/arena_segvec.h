@@ -0,0 +1,125 @@
+#ifndef ARENA_SEGVEC_H
+#define ARENA_SEGVEC_H
+
+#include <string.h>
+
+#include "../allocators/arena.h"
+
+/* arena backed segmented vector
+ * elements live in chunks that never move, so pointers to elements stay valid
+ * while the vector grows. Chunk k holds ARENA_SEGVEC_BASE << k elements, which
+ * keeps the chunk directory small and indexing O(1) (one clz). Iterate chunk
+ * by chunk with _chunk for contiguous, cache friendly loops.
+ * _snapshot/_rewind pair an arena marker with the vector length, so rewinding
+ * drops both the memory and the elements pushed after the snapshot.
+ *
+ *   ARENA_SEGVEC_DEFINE(obj_vec, struct obj)
+ *   obj_vec_t v;
+ *   obj_vec_init(&v, &arena);
+ *   struct obj *o = obj_vec_push(&v, (struct obj){0});
+ */
+
+#ifndef ARENA_SEGVEC_BASE
+#define ARENA_SEGVEC_BASE (16u) /* power of two */
+#endif
+#define ARENA_SEGVEC_MAX_CHUNKS (48u)
+
+/* chunk k starts at index BASE * (2^k - 1) */
+static inline size_t arena_segvec_chunk_of(size_t i) {
+    size_t q = i / ARENA_SEGVEC_BASE + 1;
+    return (size_t)(63 - __builtin_clzll((unsigned long long)q));
+}
+
+static inline size_t arena_segvec_chunk_start(size_t k) {
+    return (size_t)ARENA_SEGVEC_BASE * (((size_t)1 << k) - 1);
+}
+
+#define ARENA_SEGVEC_DEFINE(_name, _T)                                              \
+typedef struct _name {                                                              \
+    _T      *chunks[ARENA_SEGVEC_MAX_CHUNKS];                                       \
+    size_t   len, nchunks;                                                          \
+    arena_t *arena;                                                                 \
+} _name##_t;                                                                        \
+                                                                                    \
+typedef struct _name##_mark {                                                       \
+    arena_marker_t marker;                                                          \
+    size_t         len, nchunks;                                                    \
+} _name##_mark_t;                                                                   \
+                                                                                    \
+static inline void _name##_init(_name##_t *v, arena_t *arena) {                     \
+    memset(v->chunks, 0, sizeof(v->chunks));                                        \
+    v->len     = 0;                                                                 \
+    v->nchunks = 0;                                                                 \
+    v->arena   = arena;                                                             \
+}                                                                                   \
+                                                                                    \
+static inline _T *_name##_at(const _name##_t *v, size_t i) {                        \
+    size_t k = arena_segvec_chunk_of(i);                                            \
+    return &v->chunks[k][i - arena_segvec_chunk_start(k)];                          \
+}                                                                                   \
+                                                                                    \
+/* contiguous run of live elements in chunk k, NULL past the last one */            \
+static inline _T *_name##_chunk(const _name##_t *v, size_t k, size_t *count) {      \
+    size_t start = arena_segvec_chunk_start(k);                                     \
+    if (k >= v->nchunks || start >= v->len) return NULL;                            \
+    *count = min(v->len - start, (size_t)ARENA_SEGVEC_BASE << k);                   \
+    return v->chunks[k];                                                            \
+}                                                                                   \
+                                                                                    \
+/* returns 0 on success, -1 if the arena is out of memory */                        \
+static inline int _name##_grow(_name##_t *v) {                                      \
+    if (v->nchunks == ARENA_SEGVEC_MAX_CHUNKS) return -1;                           \
+    size_t n  = (size_t)ARENA_SEGVEC_BASE << v->nchunks;                            \
+    _T *chunk = (_T*)arena_alloc(v->arena, sizeof(_T) * n);                         \
+    if (!chunk) return -1;                                                          \
+    v->chunks[v->nchunks++] = chunk;                                                \
+    return 0;                                                                       \
+}                                                                                   \
+                                                                                    \
+static inline _T *_name##_push(_name##_t *v, _T x) {                                \
+    if (v->len == arena_segvec_chunk_start(v->nchunks) && _name##_grow(v) != 0)     \
+        return NULL;                                                                \
+    _T *slot = _name##_at(v, v->len++);                                             \
+    *slot = x;                                                                      \
+    return slot;                                                                    \
+}                                                                                   \
+                                                                                    \
+/* copies whole runs per chunk, returns 0 or -1 when out of memory */               \
+static inline int _name##_push_n(_name##_t *v, const _T *xs, size_t n) {            \
+    while (n > 0) {                                                                 \
+        if (v->len == arena_segvec_chunk_start(v->nchunks) && _name##_grow(v) != 0) \
+            return -1;                                                              \
+        size_t k    = arena_segvec_chunk_of(v->len);                                \
+        size_t room = arena_segvec_chunk_start(k + 1) - v->len;                     \
+        size_t take = min(room, n);                                                 \
+        memcpy(_name##_at(v, v->len), xs, sizeof(_T) * take);                       \
+        v->len += take;                                                             \
+        xs     += take;                                                             \
+        n      -= take;                                                             \
+    }                                                                               \
+    return 0;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* keeps the chunks, only forgets the elements */                                   \
+static inline void _name##_truncate(_name##_t *v, size_t len) {                     \
+    if (len < v->len) v->len = len;                                                 \
+}                                                                                   \
+                                                                                    \
+static inline _name##_mark_t _name##_snapshot(_name##_t *v) {                       \
+    _name##_mark_t m = {                                                            \
+        .marker  = arena_snapshot(v->arena),                                        \
+        .len     = v->len,                                                          \
+        .nchunks = v->nchunks,                                                      \
+    };                                                                              \
+    return m;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* rewinds the arena and drops the chunks and elements added since the mark */     \
+static inline void _name##_rewind(_name##_t *v, _name##_mark_t m) {                 \
+    arena_rewind(v->arena, m.marker);                                               \
+    for (size_t k = m.nchunks; k < v->nchunks; ++k) v->chunks[k] = NULL;            \
+    v->nchunks = m.nchunks;                                                         \
+    v->len     = min(v->len, m.len);                                                \
+}
+
+#endif /* ARENA_SEGVEC_H */
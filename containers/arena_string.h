@@ -0,0 +1,146 @@
+#ifndef ARENA_STRING_H
+#define ARENA_STRING_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "../allocators/arena.h"
+#include "arena_map.h"
+
+/* arena backed strings
+ * arena_strbuf_t builds a string in place: while the buffer is the last
+ * allocation of its block appends extend it without copying, and finish
+ * trims the unused capacity. arena_intern_t keeps one copy of every distinct
+ * string in the arena, so interned strings compare equal by pointer. */
+
+typedef struct arena_str {
+    const char *ptr;
+    size_t      len;
+} arena_str_t;
+
+typedef struct arena_strbuf {
+    char    *data;
+    size_t   len, cap; /* cap excludes the terminating NUL */
+    arena_t *arena;
+} arena_strbuf_t;
+
+#ifndef ARENA_STRBUF_MIN_CAP
+#define ARENA_STRBUF_MIN_CAP (32u)
+#endif
+
+static inline void arena_strbuf_init(arena_strbuf_t *sb, arena_t *arena) {
+    sb->data  = NULL;
+    sb->len   = 0;
+    sb->cap   = 0;
+    sb->arena = arena;
+}
+
+/* returns 0 on success, -1 if the arena is out of memory. A fresh builder
+ * gets its buffer here even for extra == 0, callers write the terminator */
+static inline int arena_strbuf_reserve(arena_strbuf_t *sb, size_t extra) {
+    size_t need = sb->len + extra;
+    if (need <= sb->cap && sb->data) return 0;
+    if (sb->data && arena_resize(sb->arena, sb->data, sb->cap + 1, need + 1)) {
+        sb->cap = need;
+        return 0;
+    }
+    size_t cap  = max(max(need, sb->cap * 2), (size_t)ARENA_STRBUF_MIN_CAP);
+    char  *data = (char*)arena_realloc(sb->arena, sb->data, sb->data ? sb->cap + 1 : 0, cap + 1);
+    if (!data) return -1;
+    sb->data = data;
+    sb->cap  = cap;
+    return 0;
+}
+
+static inline int arena_strbuf_append(arena_strbuf_t *sb, const char *s, size_t n) {
+    if (arena_strbuf_reserve(sb, n) != 0) return -1;
+    memcpy(&sb->data[sb->len], s, n);
+    sb->len += n;
+    sb->data[sb->len] = '\0';
+    return 0;
+}
+
+static inline int arena_strbuf_append_cstr(arena_strbuf_t *sb, const char *s) {
+    return arena_strbuf_append(sb, s, strlen(s));
+}
+
+static inline int arena_strbuf_vappendf(arena_strbuf_t *sb, const char *fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    /* try to format into the spare capacity first */
+    size_t room = sb->data ? sb->cap - sb->len + 1 : 0;
+    int n = vsnprintf(room ? &sb->data[sb->len] : NULL, room, fmt, copy);
+    va_end(copy);
+    if (n < 0) return -1;
+    if ((size_t)n >= room) {
+        if (arena_strbuf_reserve(sb, (size_t)n) != 0) return -1;
+        vsnprintf(&sb->data[sb->len], (size_t)n + 1, fmt, args);
+    }
+    sb->len += (size_t)n;
+    return 0;
+}
+
+static inline int arena_strbuf_appendf(arena_strbuf_t *sb, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = arena_strbuf_vappendf(sb, fmt, args);
+    va_end(args);
+    return r;
+}
+
+/* NUL terminated result, the builder can be reused for a new string after */
+static inline arena_str_t arena_strbuf_finish(arena_strbuf_t *sb) {
+    if (!sb->data) {
+        /* empty string still gets its own terminator */
+        sb->data = (char*)arena_alloc(sb->arena, 1);
+        if (!sb->data) return (arena_str_t){0};
+        sb->data[0] = '\0';
+    }
+    if (arena_resize(sb->arena, sb->data, sb->cap + 1, sb->len + 1)) sb->cap = sb->len;
+    arena_str_t s = { .ptr = sb->data, .len = sb->len };
+    arena_strbuf_init(sb, sb->arena);
+    return s;
+}
+
+/* string interning */
+static inline uint64_t arena_str_hash(arena_str_t s) {
+    return arena_map_hash_bytes(s.ptr, s.len);
+}
+
+static inline int arena_str_eq(arena_str_t a, arena_str_t b) {
+    return a.len == b.len && memcmp(a.ptr, b.ptr, a.len) == 0;
+}
+
+ARENA_MAP_DEFINE(arena_intern_map, arena_str_t, char, arena_str_hash, arena_str_eq)
+
+typedef struct arena_intern {
+    arena_intern_map_t map;
+    arena_t           *arena;
+} arena_intern_t;
+
+static inline void arena_intern_init(arena_intern_t *in, arena_t *arena) {
+    arena_intern_map_init(&in->map, arena);
+    in->arena = arena;
+}
+
+/* the returned copy is NUL terminated and shared by every equal string */
+static inline const char *arena_intern(arena_intern_t *in, const char *s, size_t len) {
+    arena_str_t key = { .ptr = s, .len = len };
+    size_t slot = arena_intern_map_find(&in->map, key, arena_str_hash(key));
+    if (slot != SIZE_MAX) return in->map.slots[slot].key.ptr;
+
+    char *copy = (char*)arena_alloc(in->arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    key.ptr = copy;
+    if (!arena_intern_map_put(&in->map, key, 0)) return NULL;
+    return copy;
+}
+
+static inline const char *arena_intern_cstr(arena_intern_t *in, const char *s) {
+    return arena_intern(in, s, strlen(s));
+}
+
+#endif /* ARENA_STRING_H */
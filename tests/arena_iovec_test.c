@@ -0,0 +1,90 @@
+/* arena_to_iovec against the bytes writev actually sends:
+ *   cc -std=gnu11 -I.. arena_iovec_test.c -o arena_iovec_test && ./arena_iovec_test
+ * also meant to run with -fsanitize=address, where the exported ranges must
+ * not touch poisoned memory. Append mode with arena_alloc_bytes has to export
+ * every allocation exactly once, unpadded and in allocation order, also when
+ * an allocation spills into a new block and an earlier one still has room */
+#define ALLOC_IMPL
+#include "../alloc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define check(_cond) do {                                               \
+    if (!(_cond)) {                                                     \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond); \
+        return 1;                                                       \
+    }                                                                   \
+} while (0)
+
+#define MAX_IOV (16u)
+
+/* pushes 'n' bytes of 'c' and appends them to the expected output */
+static void *push(arena_t *arena, char c, size_t n, char *expected, size_t *len) {
+    char *p = (char*)arena_alloc_bytes(arena, n);
+    if (!p) return NULL;
+    memset(p, c, n);
+    memset(expected + *len, c, n);
+    *len += n;
+    return p;
+}
+
+/* writev through a pipe and compare with 'expected' */
+static int export_matches(arena_t *arena, arena_marker_t from, const char *expected, size_t len) {
+    struct iovec iov[MAX_IOV];
+    size_t n = arena_to_iovec(arena, from, iov, MAX_IOV);
+    if (n > MAX_IOV) return 0;
+
+    int fd[2];
+    if (pipe(fd) != 0) return 0;
+    ssize_t sent = writev(fd[1], iov, (int)n);
+    close(fd[1]);
+
+    static char got[1 << 14];
+    size_t total = 0;
+    for (ssize_t r; (r = read(fd[0], got + total, sizeof(got) - total)) > 0;) total += (size_t)r;
+    close(fd[0]);
+    return sent == (ssize_t)len && total == len && memcmp(got, expected, len) == 0;
+}
+
+int main(void) {
+    static char expected[1 << 14];
+    size_t len = 0;
+
+    arena_t arena;
+    arena_init(&arena);
+    arena_set_append(&arena, 1);
+
+    /* A fills most of the first 512 byte block, B spills into the second,
+     * C would first-fit back into the first block outside append mode */
+    check(push(&arena, 'A', 400, expected, &len));
+    check(push(&arena, 'B', 300, expected, &len));
+    check(push(&arena, 'C', 64,  expected, &len));
+    check(arena.start->next != NULL);
+    check(export_matches(&arena, (arena_marker_t){0}, expected, len));
+
+    /* odd sizes stay back to back, no padding in between */
+    for (size_t i = 1; i <= 10; ++i) check(push(&arena, (char)('a' + i), i, expected, &len));
+    check(export_matches(&arena, (arena_marker_t){0}, expected, len));
+
+    /* a marker exports only what came after it */
+    arena_marker_t m = arena_snapshot(&arena);
+    size_t mark = len;
+    check(push(&arena, 'x', 10, expected, &len));
+    check(push(&arena, 'y', 2000, expected, &len));
+    check(push(&arena, 'z', 10, expected, &len));
+    check(export_matches(&arena, m, expected + mark, len - mark));
+
+    /* after a rewind the kept blocks fill up in order again */
+    arena_rewind(&arena, m);
+    len = mark;
+    check(push(&arena, 'q', 700, expected, &len));
+    check(push(&arena, 'r', 5, expected, &len));
+    check(export_matches(&arena, (arena_marker_t){0}, expected, len));
+
+    arena_deinit(&arena);
+    printf("arena_iovec_test: ok\n");
+    return 0;
+}
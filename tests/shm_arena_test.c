@@ -0,0 +1,102 @@
+/* two process test of the shared memory arena:
+ *   cc -std=gnu11 -I.. shm_arena_test.c -o shm_arena_test && ./shm_arena_test
+ * the parent creates an anonymous region and passes its fd to a forked child
+ * over a socketpair, then both sides allocate from it and ping/pong offsets */
+#define SHM_ARENA_IMPL
+#include "../allocators/shm_arena.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#define REGION_SIZE (1u << 20)
+#define ROUNDS      (1000u)
+
+#define check(_cond) do {                                               \
+    if (!(_cond)) {                                                     \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond); \
+        _exit(1);                                                       \
+    }                                                                   \
+} while (0)
+
+typedef struct message {
+    uint64_t round;
+    char     text[16];
+} message_t;
+
+static void send_off(int sock, offptr_t off) { check(write(sock, &off, sizeof(off)) == (ssize_t)sizeof(off)); }
+static offptr_t recv_off(int sock) {
+    offptr_t off;
+    check(read(sock, &off, sizeof(off)) == (ssize_t)sizeof(off));
+    return off;
+}
+
+/* answers every ping with a pong allocated from its own mapping */
+static void child(int sock) {
+    int fd = shm_arena_recv_fd(sock);
+    check(fd >= 0);
+    shm_arena_t a;
+    check(shm_arena_attach(&a, fd) == 0);
+
+    for (uint64_t i = 0; i < ROUNDS; ++i) {
+        message_t *ping = (message_t*)shm_arena_ptr(&a, recv_off(sock));
+        check(ping->round == i && strcmp(ping->text, "ping") == 0);
+
+        message_t *pong = (message_t*)shm_arena_alloc(&a, sizeof(message_t));
+        check(pong != NULL);
+        pong->round = i;
+        strcpy(pong->text, "pong");
+        send_off(sock, shm_arena_off(&a, pong));
+    }
+    shm_arena_detach(&a);
+    _exit(0);
+}
+
+int main(void) {
+    int sv[2];
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    shm_arena_t a;
+    check(shm_arena_create(&a, NULL, REGION_SIZE) == 0);
+
+    pid_t pid = fork();
+    check(pid >= 0);
+    if (pid == 0) {
+        close(sv[0]);
+        child(sv[1]);
+    }
+    close(sv[1]);
+    check(shm_arena_send_fd(sv[0], a.fd) == 0);
+
+    uint8_t *last = NULL;
+    for (uint64_t i = 0; i < ROUNDS; ++i) {
+        message_t *ping = (message_t*)shm_arena_alloc(&a, sizeof(message_t));
+        check(ping != NULL);
+        ping->round = i;
+        strcpy(ping->text, "ping");
+        send_off(sv[0], shm_arena_off(&a, ping));
+
+        /* both processes bump the same pointer, allocations never overlap */
+        message_t *pong = (message_t*)shm_arena_ptr(&a, recv_off(sv[0]));
+        check(pong->round == i && strcmp(pong->text, "pong") == 0);
+        check((uint8_t*)pong >= (uint8_t*)(ping + 1));
+        check((uint8_t*)ping >= last);
+        last = (uint8_t*)(pong + 1);
+    }
+
+    int status;
+    check(waitpid(pid, &status, 0) == pid);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    /* a request that does not fit fails alone, the region stays usable */
+    check(shm_arena_alloc(&a, 2 * REGION_SIZE) == NULL);
+    check(shm_arena_alloc(&a, SIZE_MAX) == NULL);
+    check(shm_arena_alloc(&a, 16) != NULL);
+
+    shm_arena_detach(&a);
+    close(sv[0]);
+    printf("shm_arena_test: ok\n");
+    return 0;
+}